@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+
+#include "async_sink.hpp"
+#include "detail/line_buffer.hpp"
+
+namespace dbglog {
+
+async_sink::async_sink(const Sink::pointer &sink, std::size_t capacity
+                       , overflow_policy policy, const mask &keep)
+    : Sink(mask(sink->get_mask()), sink->name())
+    , sink_(sink), policy_(policy), keep_(~keep.get())
+    , queue_(std::max(capacity, std::size_t(1))), head_(0), count_(0)
+    , removed_(0), busy_(false), running_(true), stats_()
+{
+    shared_mask(sink_->shared_mask());
+    sink_->add_listener(this);
+    thread_ = boost::thread(&async_sink::run, this);
+}
+
+async_sink::~async_sink()
+{
+    sink_->remove_listener(this);
+    {
+        boost::mutex::scoped_lock guard(m_);
+        running_ = false;
+        wakeup_.notify_one();
+    }
+    thread_.join();
+}
+
+void async_sink::sink_mask_changed()
+{
+    set_mask(sink_->get_mask());
+}
+
+void async_sink::write(const std::string &line)
+{
+    sink_->write(line);
+}
+
+void async_sink::write_record(const record &r)
+{
+    // writer thread logging into this sink must not wait for itself
+    const bool writer(boost::this_thread::get_id() == thread_.get_id());
+
+    boost::mutex::scoped_lock guard(m_);
+    if (full()) {
+        auto policy(policy_);
+        if ((policy == overflow_policy::drop_by_level)
+            || ((policy == overflow_policy::block) && writer))
+        {
+            const bool keep(!(keep_ & r.l) || (r.l == fatal));
+            policy = ((keep && !writer) ? overflow_policy::block
+                      : overflow_policy::drop_newest);
+        }
+
+        switch (policy) {
+        case overflow_policy::block:
+            while (full()) { done_.wait(guard); }
+            break;
+
+        case overflow_policy::drop_oldest:
+            head_ = (head_ + 1) % queue_.size();
+            --count_;
+            ++removed_;
+            ++stats_.dropped;
+            break;
+
+        default:
+            ++stats_.dropped;
+            return;
+        }
+    }
+
+    queue_[(head_ + count_) % queue_.size()].assign(r);
+    ++count_;
+    ++stats_.enqueued;
+    stats_.high_water = std::max(stats_.high_water, count_);
+    if (!busy_) { wakeup_.notify_one(); }
+}
+
+void async_sink::flush()
+{
+    if (boost::this_thread::get_id() == thread_.get_id()) { return; }
+
+    boost::mutex::scoped_lock guard(m_);
+    const auto target(stats_.enqueued);
+    while (removed_ < target) { done_.wait(guard); }
+}
+
+async_sink_stats async_sink::stats() const
+{
+    boost::mutex::scoped_lock guard(m_);
+    return stats_;
+}
+
+void async_sink::run()
+{
+    boost::mutex::scoped_lock guard(m_);
+    for (;;) {
+        while (!count_ && running_) { wakeup_.wait(guard); }
+        // stopped and drained
+        if (!count_) { break; }
+
+        // take record out of the queue, producers can go on meanwhile
+        current_.swap(queue_[head_]);
+        head_ = (head_ + 1) % queue_.size();
+        --count_;
+        busy_ = true;
+        done_.notify_all();
+
+        guard.unlock();
+        try {
+            detail::scoped_line_stream text;
+            const record r(current_, *text);
+            sink_->write_record(r);
+        } catch (...) {
+            // nowhere to report; never let the writer thread die
+        }
+        guard.lock();
+
+        busy_ = false;
+        ++removed_;
+        ++stats_.written;
+        done_.notify_all();
+    }
+}
+
+} // namespace dbglog
@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef shared_dbglog_async_sink_hpp_included_
+#define shared_dbglog_async_sink_hpp_included_
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/thread.hpp>
+
+#include "sink.hpp"
+#include "record.hpp"
+
+namespace dbglog {
+
+/** What async_sink does with a record that doesn't fit into its queue.
+ */
+enum class overflow_policy {
+    /** Logging thread waits for free space, nothing is lost.
+     */
+    block
+    /** New record is dropped.
+     */
+    , drop_newest
+    /** Oldest queued record is dropped to make room for the new one.
+     */
+    , drop_oldest
+    /** New record is dropped unless its level passes keep mask; such
+     *  records block.
+     */
+    , drop_by_level
+};
+
+/** Counters of async_sink.
+ */
+struct async_sink_stats {
+    /** Records accepted into the queue.
+     */
+    std::uint64_t enqueued;
+
+    /** Records lost due to overflow (newest or oldest).
+     */
+    std::uint64_t dropped;
+
+    /** Records handed over to wrapped sink.
+     */
+    std::uint64_t written;
+
+    /** Maximum number of records ever queued at once.
+     */
+    std::size_t high_water;
+};
+
+/** Sink adapter writing to wrapped sink from its own thread, i.e. slow sink
+ *  doesn't stall logging threads. Records are copied into bounded queue of
+ *  capacity records; what happens when queue is full is decided by
+ *  overflow policy.
+ *
+ *  Adapter takes over wrapped sink's name and mask and follows its mask
+ *  changes; add the adapter (not the wrapped sink) to the logger.
+ *  Pending records are written before the adapter is destroyed.
+ */
+class async_sink : public Sink, private Sink::mask_listener {
+public:
+    async_sink(const Sink::pointer &sink
+               , std::size_t capacity = DefaultCapacity
+               , overflow_policy policy = overflow_policy::block
+               , const mask &keep = mask(warn1 | err1));
+
+    virtual ~async_sink();
+
+    virtual void write_record(const record &r);
+
+    /** Plain line (no record to queue) goes directly to wrapped sink.
+     */
+    virtual void write(const std::string &line);
+
+    /** Waits until all records queued before this call are written.
+     */
+    void flush();
+
+    async_sink_stats stats() const;
+
+    const Sink::pointer& sink() const { return sink_; }
+
+    overflow_policy policy() const { return policy_; }
+
+    static const std::size_t DefaultCapacity = 1024;
+
+private:
+    virtual void sink_mask_changed();
+
+    void run();
+
+    bool full() const { return count_ == queue_.size(); }
+
+    const Sink::pointer sink_;
+    const overflow_policy policy_;
+
+    /** Negated keep mask (as in Sink).
+     */
+    const unsigned int keep_;
+
+    mutable boost::mutex m_;
+    boost::condition_variable wakeup_;
+    boost::condition_variable done_;
+
+    /** Queued records: count_ records starting at head_.
+     */
+    std::vector<detail::record_copy> queue_;
+    std::size_t head_;
+    std::size_t count_;
+
+    /** Record being written, swapped out of the queue.
+     */
+    detail::record_copy current_;
+
+    /** Number of records removed from the queue (written or dropped
+     *  oldest); flush waits for it.
+     */
+    std::uint64_t removed_;
+
+    /** Set while writer handles current_.
+     */
+    bool busy_;
+    bool running_;
+
+    async_sink_stats stats_;
+
+    boost::thread thread_;
+};
+
+} // namespace dbglog
+
+#endif // shared_dbglog_async_sink_hpp_included_
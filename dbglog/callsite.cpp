@@ -0,0 +1,186 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "callsite.hpp"
+
+namespace dbglog {
+
+namespace {
+
+struct rule {
+    std::string file;
+    std::string func;
+    std::string line;
+    callsite_state state;
+
+    bool all() const { return (file == "*") && (func == "*") && (line == "*"); }
+};
+
+/** Registry of call sites and rules; call sites are registered on first use
+ *  and unregistered at exit (or when their library is unloaded).
+ */
+struct registry {
+    boost::mutex lock;
+    std::vector<detail::callsite*> sites;
+    std::vector<rule> rules;
+};
+
+registry& getRegistry()
+{
+    static registry r;
+    return r;
+}
+
+/** Glob match: '*' matches any string, '?' any single character.
+ */
+bool globMatch(const char *pattern, const char *str)
+{
+    // position of last star in pattern and string position it matches from
+    const char *star(nullptr);
+    const char *resume(nullptr);
+
+    while (*str) {
+        if ((*pattern == '?') || ((*pattern != '*') && (*pattern == *str))) {
+            ++pattern;
+            ++str;
+        } else if (*pattern == '*') {
+            star = pattern++;
+            resume = str;
+        } else if (star) {
+            // let last star eat one more character
+            pattern = star + 1;
+            str = ++resume;
+        } else {
+            return false;
+        }
+    }
+
+    while (*pattern == '*') { ++pattern; }
+    return !*pattern;
+}
+
+bool matches(const rule &r, const detail::callsite &site)
+{
+    return (globMatch(r.file.c_str(), site.loc.file)
+            && globMatch(r.func.c_str(), site.loc.func)
+            && globMatch(r.line.c_str()
+                         , boost::lexical_cast<std::string>
+                         (site.loc.line).c_str()));
+}
+
+/** State of site given by last matching rule.
+ */
+callsite_state ruleState(const registry &r, const detail::callsite &site)
+{
+    for (auto irules(r.rules.rbegin()), erules(r.rules.rend());
+         irules != erules; ++irules)
+    {
+        if (matches(*irules, site)) { return irules->state; }
+    }
+    return callsite_state::mask;
+}
+
+} // namespace
+
+namespace detail {
+
+callsite::callsite(const location &loc, level l)
+    : loc(loc), l(l), state(callsite_state::mask), format(nullptr)
+{
+    auto &r(getRegistry());
+    boost::mutex::scoped_lock guard(r.lock);
+    state.store(ruleState(r, *this), std::memory_order_relaxed);
+    r.sites.push_back(this);
+}
+
+callsite::~callsite()
+{
+    auto &r(getRegistry());
+    boost::mutex::scoped_lock guard(r.lock);
+    r.sites.erase(std::remove(r.sites.begin(), r.sites.end(), this)
+                  , r.sites.end());
+    // format is intentionally leaked, see callsite::format
+}
+
+} // namespace detail
+
+std::vector<callsite_info> list_callsites()
+{
+    auto &r(getRegistry());
+    boost::mutex::scoped_lock guard(r.lock);
+
+    std::vector<callsite_info> list;
+    list.reserve(r.sites.size());
+    for (const auto *site : r.sites) {
+        list.push_back({ site->loc.file, site->loc.func, site->loc.line
+                    , site->l, site->state.load() });
+    }
+    return list;
+}
+
+std::size_t set_callsite_state(callsite_state state
+                               , const std::string &file
+                               , const std::string &func
+                               , const std::string &line)
+{
+    const rule newRule{ file, func, line, state };
+
+    auto &r(getRegistry());
+    boost::mutex::scoped_lock guard(r.lock);
+
+    if (newRule.all()) {
+        r.rules.clear();
+    } else {
+        // same pattern again: replace
+        r.rules.erase(std::remove_if(r.rules.begin(), r.rules.end()
+                                     , [&](const rule &old) {
+                                         return ((old.file == file)
+                                                 && (old.func == func)
+                                                 && (old.line == line));
+                                     })
+                      , r.rules.end());
+    }
+
+    // back to default for everything -> no rule needed
+    if (!(newRule.all() && (state == callsite_state::mask))) {
+        r.rules.push_back(newRule);
+    }
+
+    std::size_t count(0);
+    for (auto *site : r.sites) {
+        if (matches(newRule, *site)) {
+            site->state.store(state, std::memory_order_relaxed);
+            ++count;
+        }
+    }
+    return count;
+}
+
+} // namespace dbglog
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef shared_dbglog_callsite_hpp_included_
+#define shared_dbglog_callsite_hpp_included_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+#include "level.hpp"
+#include "location.hpp"
+#include "detail/limit.hpp"
+#include "detail/format.hpp"
+
+namespace dbglog {
+
+/** Runtime state of LOG/LOGR call site.
+ */
+enum class callsite_state {
+    /** Logged if allowed by logger's (module's) mask, default.
+     */
+    mask
+    /** Always logged to log file and console (sinks use their own masks).
+     */
+    , on
+    /** Never logged.
+     */
+    , off
+};
+
+/** Call site description, see list_callsites.
+ */
+struct callsite_info {
+    std::string file;
+    std::string func;
+    std::size_t line;
+    level l;
+    callsite_state state;
+};
+
+/** Returns all call sites executed so far.
+ *
+ *  Thread safety: thread safe.
+ */
+std::vector<callsite_info> list_callsites();
+
+/** Sets state of all call sites matching given globs ('*' matches any
+ *  string, '?' any character) of file basename, function name and line
+ *  number. Rule is remembered and applied to call sites executed later as
+ *  well, last matching rule wins; rule matching everything replaces all
+ *  previous ones. Returns number of matching call sites executed so far.
+ *
+ *  Call sites removed at compile time (DBGLOG_COMPILE_MASK) cannot be
+ *  turned on.
+ *
+ *  Thread safety: thread safe.
+ */
+std::size_t set_callsite_state(callsite_state state
+                               , const std::string &file
+                               , const std::string &func = "*"
+                               , const std::string &line = "*");
+
+namespace detail {
+
+/** LOG/LOGR call site, one static instance per statement. Registered in
+ *  call site registry on first use.
+ */
+struct callsite : boost::noncopyable {
+    callsite(const location &loc, level l);
+    ~callsite();
+
+    const location loc;
+
+    /** Level of first use (LOGR can use different levels).
+     */
+    const level l;
+
+    std::atomic<callsite_state> state;
+
+    /** Format string parsed on first LOG(...)(format, args...) use. Never
+     *  freed (like location::preformat): call site may be used from other
+     *  statics' destructors after its own static is gone.
+     */
+    mutable std::atomic<const parsed_format*> format;
+};
+
+/** Result of call site check. Converts to true if statement is to be
+ *  skipped: LOG macros log in else branch to be safe in unbraced if/else.
+ */
+struct callsite_check {
+    const callsite &site;
+    bool skip;
+    bool force;
+
+    /** Statements suppressed by rate limiter since last logged one.
+     */
+    std::uint64_t suppressed;
+
+    explicit operator bool() const { return skip; }
+};
+
+/** Checks call site's state and, if it follows mask, sink's level.
+ */
+template <typename SinkType>
+inline callsite_check check_callsite(const callsite &site, level l
+                                     , const SinkType &sink)
+{
+    switch (site.state.load(std::memory_order_relaxed)) {
+    case callsite_state::on: return { site, false, true, 0 };
+    case callsite_state::off: return { site, true, false, 0 };
+    default: break;
+    }
+    return { site, !sink.check_level(l), false, 0 };
+}
+
+/** Same as above, statement passing the check is subject to rate limiter
+ *  (see detail/limit.hpp; args are limiter's parameters).
+ */
+template <typename SinkType, typename Limiter, typename ...Args>
+inline callsite_check check_callsite(const callsite &site, level l
+                                     , const SinkType &sink
+                                     , Limiter &limiter, Args &&...args)
+{
+    auto check(check_callsite(site, l, sink));
+    if (check.skip) { return check; }
+
+    const auto limit(limiter.check(std::forward<Args>(args)...));
+    check.skip = !limit.pass;
+    check.suppressed = limit.suppressed;
+    return check;
+}
+
+} // namespace detail
+
+} // namespace dbglog
+
+#endif // shared_dbglog_callsite_hpp_included_
@@ -29,5 +29,23 @@
 
 #include "level.hpp"
 
+/** Build-time log mask: LOG/LOGR/LOGONCE call sites of levels not allowed by
+ *  this mask (same semantics as runtime mask, e.g. dbglog::noDebug) compile
+ *  to nothing and their arguments are never evaluated. Fatal level is always
+ *  compiled in.
+ */
+#ifndef DBGLOG_COMPILE_MASK
+#  define DBGLOG_COMPILE_MASK dbglog::all
+#endif
+
+/** True if given level is compiled in. Constant expression for constant
+ *  level, i.e. disabled call sites are eliminated by the compiler.
+ */
+#define DBGLOG_COMPILED_IN(LEVEL)                                       \
+    (!(~static_cast<unsigned int>(DBGLOG_COMPILE_MASK)                  \
+       & static_cast<unsigned int>(LEVEL))                              \
+     || (static_cast<unsigned int>(LEVEL)                               \
+         == static_cast<unsigned int>(dbglog::fatal)))
+
 #endif // shared_dbglog_config_hpp_included_
 
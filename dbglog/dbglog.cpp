@@ -24,12 +24,16 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sstream>
+#include <cstring>
+
 #include "detail/log_helpers.hpp"
 #include "detail/logger.hpp"
 
 namespace dbglog {
 
 const std::string logger::empty_;
+const unsigned int logger::forcedMask_(0);
 
 namespace detail {
 
@@ -67,4 +71,20 @@ int process_id()
     return detail::processId();
 }
 
+location location::preformat(const char *file, const char *func
+                             , size_t line)
+{
+    location loc(file, func, line);
+
+    std::ostringstream os;
+    os << loc;
+    const auto text(os.str());
+
+    auto *formatted(new char[text.size()]);
+    std::memcpy(formatted, text.data(), text.size());
+    loc.formatted = formatted;
+    loc.formattedSize = text.size();
+    return loc;
+}
+
 } // namespace dbglog
@@ -30,10 +30,14 @@
 #include "stream.hpp"
 #include "config.hpp"
 #include "mask.hpp"
+#include "callsite.hpp"
+#include "async_sink.hpp"
+#include "json_sink.hpp"
 
 namespace dbglog {
     const unsigned short millis(3);
     const unsigned short micros(6);
+    const unsigned short nanos(9);
 
     /** Thread safety: thread safe.
      */
@@ -48,7 +52,7 @@ namespace dbglog {
         return module(name, detail::deflog);
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline void set_mask(unsigned int mask)
     {
@@ -60,55 +64,71 @@ namespace dbglog {
         return detail::deflog.set_mask(m);
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline void set_mask(const std::string &m)
     {
         return detail::deflog.set_mask(mask(m));
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline unsigned int get_mask()
     {
         return detail::deflog.get_mask();
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline std::string get_mask_string()
     {
         return detail::deflog.get_mask_string();
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline void log_thread(bool value = true)
     {
         return detail::deflog.log_thread(value);
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline void log_pid(bool value = true)
     {
         return detail::deflog.log_pid(value);
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline void log_console(bool value = true)
     {
         return detail::deflog.log_console(value);
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline bool get_log_console()
     {
         return detail::deflog.get_log_console();
     }
 
+    /** Escapes control characters in messages (see logger::log_sanitize).
+     *
+     *  Thread safety: thread safe.
+     */
+    inline void log_sanitize(bool value = true)
+    {
+        detail::deflog.log_sanitize(value);
+    }
+
+    /** Thread safety: thread safe.
+     */
+    inline bool get_log_sanitize()
+    {
+        return detail::deflog.get_log_sanitize();
+    }
+
     /** Thread safety: thread safe.
      */
     inline bool log_file(const std::string &filename)
@@ -123,6 +143,94 @@ namespace dbglog {
         return detail::deflog.log_file_truncate();
     }
 
+    /** Buffers log file output: lines are written in batches of up to
+     *  bufferSize bytes, at latest after flushInterval milliseconds; error
+     *  and fatal lines are written immediately. Zero bufferSize switches
+     *  buffering off.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline bool log_file_buffer(std::size_t bufferSize
+                                , unsigned int flushInterval
+                                = logger_file::DefaultFlushInterval)
+    {
+        return detail::deflog.log_file_buffer(bufferSize, flushInterval);
+    }
+
+    /** Writes log file via io_uring (Linux only): logging threads only queue
+     *  lines, error and fatal lines are waited for. Returns false if not
+     *  available (synchronous writes are kept).
+     *
+     *  Thread safety: thread safe.
+     */
+    inline bool log_file_uring(bool value = true)
+    {
+        return detail::deflog.log_file_uring(value);
+    }
+
+    /** Writes log file through its memory mapping preallocated in chunks of
+     *  chunkSize bytes, zero switches it off. File is truncated to used
+     *  length when closed. Returns false if not available.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline bool log_file_mmap(std::size_t chunkSize
+                              = logger_file::DefaultMmapChunkSize)
+    {
+        return detail::deflog.log_file_mmap(chunkSize);
+    }
+
+    /** Rotates log file by size (bytes) and/or UTC wall clock interval
+     *  (seconds), keeping keep older generations (filename.1 is the newest
+     *  one). Zero limits switch rotation off. Returns false if not
+     *  available.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline bool log_file_rotate(std::uint64_t maxSize
+                                , unsigned int interval = 0
+                                , unsigned int keep
+                                = logger_file::DefaultRotateKeep)
+    {
+        return detail::deflog.log_file_rotate(maxSize, interval, keep);
+    }
+
+    /** Thread safety: thread safe.
+     */
+    inline bool log_file_rotate_now()
+    {
+        return detail::deflog.log_file_rotate_now();
+    }
+
+    /** Gzips rotated generations in a low priority background thread
+     *  reading at most rate bytes per second (0: unlimited) and removes the
+     *  oldest ones over budget bytes in total (0: no limit). Returns false
+     *  if not available.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline bool log_file_compress(bool value = true
+                                  , std::uint64_t rate
+                                  = logger_file::DefaultCompressRate
+                                  , std::uint64_t budget = 0)
+    {
+        return detail::deflog.log_file_compress(value, rate, budget);
+    }
+
+    /** Writes log file as independently gzipped blocks of about blockSize
+     *  bytes indexed by time and levels in filename.idx (see dbglog-blocks),
+     *  zero switches it off. Returns false if not available.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline bool log_file_blocks(std::size_t blockSize
+                                = logger_file::DefaultBlockSize
+                                , unsigned int flushInterval
+                                = logger_file::DefaultFlushInterval)
+    {
+        return detail::deflog.log_file_blocks(blockSize, flushInterval);
+    }
+
     /** Thread safety: thread safe.
      */
     inline bool log_file_owner(long uid, long gid)
@@ -130,6 +238,61 @@ namespace dbglog {
         return detail::deflog.log_file_owner(uid, gid);
     }
 
+    /** Opens binary log file for LOGB lines, empty filename closes it. Use
+     *  dbglog-decode to turn it into text.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline bool log_binary_file(const std::string &filename)
+    {
+        return detail::deflog.log_binary_file(filename);
+    }
+
+    /** Switches asynchronous logging on/off. Each thread queues its lines in
+     *  its own ring of queueSize lines per severity lane, a background thread
+     *  writes them out. Lines of levels in shed mask are dropped when their
+     *  lane is full.
+     *
+     *  Thread safety: none.
+     */
+    inline void log_async(bool value = true
+                          , std::size_t queueSize
+                          = logger::DefaultAsyncQueueSize
+                          , const mask &shed = mask(none))
+    {
+        detail::deflog.log_async(value, queueSize, shed);
+    }
+
+    /** Thread safety: thread safe.
+     */
+    inline async_lane_stats async_stats(async_lane lane) {
+        return detail::deflog.async_stats(lane);
+    }
+
+    /** Thread safety: thread safe.
+     */
+    inline bool get_log_async() {
+        return detail::deflog.get_log_async();
+    }
+
+    /** Waits until all lines queued so far are written, including lines
+     *  buffered by log_file_buffer.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline void flush() {
+        detail::deflog.flush();
+    }
+
+    /** Writes all queued lines and stops asynchronous writer; logging
+     *  continues synchronously. Called automatically at exit.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline void shutdown() {
+        detail::deflog.shutdown();
+    }
+
     /** Thread safety: thread safe.
      */
     void thread_id(const std::string &id);
@@ -138,31 +301,32 @@ namespace dbglog {
      */
     std::string thread_id();
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline void log_time_precision(unsigned short precision) {
         detail::deflog.log_time_precision(precision);
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
      */
     inline unsigned short log_time_precision() {
         return detail::deflog.log_time_precision();
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe (not from Sink::write).
      */
     inline void add_sink(const Sink::pointer &sink) {
         detail::deflog.addSink(sink);
     }
 
-/** Thread safety: none.
+    /** Thread safety: thread safe (not from Sink::write). Removed sink is
+     *  not used by any thread after return.
      */
     inline void remove_sink(const Sink::pointer &sink) {
         detail::deflog.removeSink(sink);
     }
 
-     /** Thread safety: none.
+    /** Thread safety: thread safe (not from Sink::write).
      */
     inline void clear_sinks() {
         detail::deflog.clearSinks();
@@ -186,15 +350,27 @@ namespace dbglog {
         return detail::deflog.closeOnExec(value);
     }
 
-    /** Thread safety: none.
+    /** Collapses repeated lines: first one is logged, its repetitions are
+     *  reported as "last message repeated N times" once the thread logs
+     *  another line or timeout (ms) expires. Zero switches it off.
+     *
+     *  Thread safety: thread safe.
+     */
+    inline void log_collapse_repeated(unsigned int timeout
+                                      = logger::DefaultRepeatTimeout)
+    {
+        detail::deflog.log_collapse_repeated(timeout);
+    }
+
+    /** Thread safety: thread safe.
      */
     inline void log_line_prefix(const std::string &prefix) {
         detail::deflog.set_prefix(prefix);
     }
 
-    /** Thread safety: none.
+    /** Thread safety: thread safe.
     */
-    inline const std::string& log_line_prefix() {
+    inline std::string log_line_prefix() {
         return detail::deflog.get_prefix();
     }
 
@@ -239,6 +415,58 @@ namespace dbglog {
     DBGLOG_CONCATENATE(DBGLOG_ONCE_EXPAND_, DBGLOG_NARG(__VA_ARGS__) \
                        (__VA_ARGS__))
 
+/** Rate limited log facilities, limits are kept per call site.
+ *  Usage:
+ *      Log 1st, 11th, 21st... line:
+ *          LOG_EVERY_N(info1, 10) << "text";
+ *      Log first 10 lines only:
+ *          LOG_FIRST_N(info1, 10) << "text";
+ *      Log at most one line per 5 seconds:
+ *          LOG_EVERY_T(info1, 5.0) << "text";
+ *      Log at most 100 lines per second, bursts of up to 20 lines (token
+ *      bucket):
+ *          LOG_RATE(err2, 100, 20) << "text";
+ *
+ *  Logger can be given as the last argument as in LOG. Only lines allowed by
+ *  the mask are counted. Logged line carries number of lines suppressed since
+ *  the previous one, e.g. "text (suppressed 9 messages)".
+ */
+#define LOG_EVERY_N(...) \
+    DBGLOG_CONCATENATE(DBGLOG_EVERY_N_EXPAND_, DBGLOG_NARG(__VA_ARGS__) \
+                       (__VA_ARGS__))
+
+#define LOG_FIRST_N(...) \
+    DBGLOG_CONCATENATE(DBGLOG_FIRST_N_EXPAND_, DBGLOG_NARG(__VA_ARGS__) \
+                       (__VA_ARGS__))
+
+#define LOG_EVERY_T(...) \
+    DBGLOG_CONCATENATE(DBGLOG_EVERY_T_EXPAND_, DBGLOG_NARG(__VA_ARGS__) \
+                       (__VA_ARGS__))
+
+#define LOG_RATE(...) \
+    DBGLOG_CONCATENATE(DBGLOG_RATE_EXPAND_, DBGLOG_NARG(__VA_ARGS__) \
+                       (__VA_ARGS__))
+
+/** Binary (deferred formatting) log facility.
+ *  Usage:
+ *      LOGB(info1)("Request %s took %d ms.", id, ms);
+ *      LOGB(info1, L)("Request %s took %d ms.", id, ms);
+ *
+ *  With binary log file open (dbglog::log_binary_file) only the call site
+ *  identifier, time, thread and raw arguments are written; format string and
+ *  location are written once per call site. Without binary log file it is
+ *  the same as LOG(level)(format, args...).
+ *
+ *  L must have this in addition to LoggerConcept:
+ *
+ *      template <typename ...Args>
+ *      bool log_binary(dbglog::detail::binary_callsite &site
+ *                      , const char *format, Args &&...args);
+ */
+#define LOGB(...) \
+    DBGLOG_CONCATENATE(DBGLOG_BINARY_EXPAND_, DBGLOG_NARG(__VA_ARGS__) \
+                       (__VA_ARGS__))
+
 /** Log'n'throw convenience logger.
  *
  *  Same as LOG but throws exception of given type (2nd or 3rd) initialized with
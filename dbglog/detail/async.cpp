@@ -0,0 +1,519 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <array>
+
+#include "async.hpp"
+#include "line_buffer.hpp"
+
+namespace dbglog { namespace detail {
+
+struct async_writer::ring : boost::noncopyable {
+    /** Copy of pushed record with producer's own flag and sequence number
+     *  (order of records among lanes).
+     */
+    struct slot : record_copy {
+        bool own;
+        std::uint64_t seq;
+
+        slot() : own(false), seq(0) {}
+
+        void assign(const record &r, bool own, std::uint64_t seq) {
+            record_copy::assign(r);
+            this->own = own;
+            this->seq = seq;
+        }
+    };
+
+    /** One severity lane; slots are allocated by producer on first use
+     *  (published together with first record).
+     */
+    struct lane : boost::noncopyable {
+        lane()
+            : capacity(0), head(0), tail(0), enqueued(0), dropped(0)
+            , high_water(0)
+        {}
+
+        bool empty() const {
+            return (head.load(std::memory_order_acquire)
+                    == tail.load(std::memory_order_acquire));
+        }
+
+        std::size_t capacity;
+        std::unique_ptr<slot[]> slots;
+
+        /** Index of next record to be written by writer thread. Advanced
+         *  only after record's output is finished.
+         */
+        std::atomic<std::size_t> head;
+
+        /** Index of next record to be filled by producer thread.
+         */
+        std::atomic<std::size_t> tail;
+
+        /** Counters, written by producer thread only (no read-modify-write
+         *  needed), read by stats().
+         */
+        std::atomic<std::uint64_t> enqueued;
+        std::atomic<std::uint64_t> dropped;
+        std::atomic<std::size_t> high_water;
+    };
+
+    ring(std::uint64_t owner, std::size_t capacity)
+        : owner(owner), pushing(false), seq(0), next(0)
+    {
+        for (auto &l : lanes) { l.capacity = capacity; }
+    }
+
+    bool empty() const {
+        for (const auto &l : lanes) {
+            if (!l.empty()) { return false; }
+        }
+        return true;
+    }
+
+    /** Owning writer's identifier.
+     */
+    const std::uint64_t owner;
+
+    /** Producer is inside push() having seen the writer running; shutdown()
+     *  waits until it leaves.
+     */
+    std::atomic<bool> pushing;
+
+    lane lanes[LaneCount];
+
+    /** Sequence number of next record, producer only. Shed records get
+     *  none, i.e. sequence has no gaps.
+     */
+    std::uint64_t seq;
+
+    /** Sequence number of next record to be written, writer only.
+     */
+    std::uint64_t next;
+};
+
+namespace {
+
+std::atomic<std::uint64_t> writerIdGenerator(0);
+
+/** Rings of calling thread, one per async writer it has ever logged to.
+ */
+thread_local std::vector<std::shared_ptr<async_writer::ring> > localRings;
+
+/** Set in writer thread.
+ */
+thread_local bool inWriterThread(false);
+
+/** Maps level to its lane.
+ */
+std::size_t laneIndex(level l)
+{
+    if (l & fatal) { return std::size_t(async_lane::fatal); }
+    if (l & err1) { return std::size_t(async_lane::err); }
+    if (l & warn1) { return std::size_t(async_lane::warn); }
+    if (l & info1) { return std::size_t(async_lane::info); }
+    return std::size_t(async_lane::debug);
+}
+
+} // namespace
+
+async_writer::async_writer(const output_type &output)
+    : output_(output), capacity_(1), shed_(none), retired_(), id_(0)
+    , sleeping_(false), running_(false), started_(false)
+{
+}
+
+void async_writer::start(std::size_t capacity, unsigned int shed)
+{
+    boost::mutex::scoped_lock shutdownGuard(shutdown_m_);
+    shed_ = shed;
+    if (thread_.joinable()) { return; }
+
+    {
+        // rings of previous run are drained, threads drop them once they
+        // register new ones
+        boost::mutex::scoped_lock guard(m_);
+        for (const auto &r : rings_) { retire(*r); }
+        rings_.clear();
+    }
+
+    capacity_ = std::max(capacity, std::size_t(1));
+    id_ = ++writerIdGenerator;
+
+    // seq_cst: producer seeing the writer running sees new id as well
+    running_.store(true);
+    started_.store(true);
+    thread_ = boost::thread(&async_writer::run, this);
+}
+
+async_writer::~async_writer()
+{
+    shutdown();
+}
+
+bool async_writer::in_writer()
+{
+    return inWriterThread;
+}
+
+async_writer::ring* async_writer::local(bool create)
+{
+    const auto id(id_.load());
+    for (const auto &r : localRings) {
+        if (r->owner == id) { return r.get(); }
+    }
+    if (!create) { return nullptr; }
+
+    // first log from this thread -> register new ring
+    auto r(std::make_shared<ring>(id, capacity_.load()));
+    {
+        boost::mutex::scoped_lock guard(m_);
+        rings_.push_back(r);
+    }
+
+    // forget rings of dead writers
+    localRings.erase(std::remove_if(localRings.begin(), localRings.end()
+                                    , [](const std::shared_ptr<ring> &r)
+                                    {
+                                        return r.use_count() == 1;
+                                    })
+                     , localRings.end());
+
+    localRings.push_back(r);
+    return r.get();
+}
+
+void async_writer::push(const record &rec, bool own)
+{
+    auto *local(this->local(running_.load()));
+    if (!local) {
+        // writer is gone, write synchronously
+        write_stopped(nullptr, rec, own);
+        return;
+    }
+
+    // mark in-flight push before checking running_; seq_cst pairs with
+    // shutdown(): either we see the writer stopped or shutdown waits for us
+    // (ring registered after shutdown looked at rings sees it stopped)
+    local->pushing.store(true);
+    struct pushed {
+        std::atomic<bool> *pushing;
+        void release() {
+            if (pushing) { pushing->store(false); pushing = nullptr; }
+        }
+        ~pushed() { release(); }
+    } inFlight{&local->pushing};
+
+    if (!running_.load()) {
+        // writer is gone, write synchronously
+        inFlight.release();
+        write_stopped(local, rec, own);
+        return;
+    }
+
+    auto &r(*local);
+    const auto index(laneIndex(rec.l));
+    auto &lane(r.lanes[index]);
+    const auto capacity(lane.capacity);
+    if (!lane.slots) { lane.slots.reset(new ring::slot[capacity]); }
+
+    const auto tail(lane.tail.load(std::memory_order_relaxed));
+    auto full([&]() {
+            return ((tail - lane.head.load(std::memory_order_acquire))
+                    >= capacity);
+        });
+
+    if (full()) {
+        if (!(~shed_.load(std::memory_order_relaxed) & rec.l)
+            && (rec.l != fatal))
+        {
+            // shed record, keep writer busy with more important ones
+            lane.dropped.store
+                (lane.dropped.load(std::memory_order_relaxed) + 1
+                 , std::memory_order_relaxed);
+            if (sleeping_.load()) { wakeup(); }
+            return;
+        }
+
+        // lane is full, kick writer and wait for some free space
+        boost::mutex::scoped_lock guard(m_);
+        wakeup_.notify_one();
+        while (full()) {
+            if (!running_.load()) {
+                // writer stopped meanwhile
+                guard.unlock();
+                inFlight.release();
+                write_stopped(local, rec, own);
+                return;
+            }
+            done_.timed_wait(guard, boost::posix_time::milliseconds(10));
+        }
+    }
+
+    lane.slots[tail % capacity].assign(rec, own, r.seq++);
+
+    // publish record; seq_cst pairs with sleeping_ handling in run()
+    lane.tail.store(tail + 1);
+
+    // counters are ours only, plain stores do
+    lane.enqueued.store(lane.enqueued.load(std::memory_order_relaxed) + 1
+                        , std::memory_order_relaxed);
+    const std::size_t fill
+        (tail + 1 - lane.head.load(std::memory_order_relaxed));
+    if (fill > lane.high_water.load(std::memory_order_relaxed)) {
+        lane.high_water.store(fill, std::memory_order_relaxed);
+    }
+
+    if (sleeping_.load()) { wakeup(); }
+}
+
+async_lane_stats async_writer::stats(async_lane lane) const
+{
+    const auto index(static_cast<std::size_t>(lane));
+
+    boost::mutex::scoped_lock guard(m_);
+    auto stats(retired_[index]);
+    for (const auto &r : rings_) {
+        const auto &l(r->lanes[index]);
+        stats.enqueued += l.enqueued.load(std::memory_order_relaxed);
+        stats.dropped += l.dropped.load(std::memory_order_relaxed);
+        stats.high_water = std::max
+            (stats.high_water, l.high_water.load(std::memory_order_relaxed));
+    }
+    return stats;
+}
+
+void async_writer::retire(const ring &r)
+{
+    for (std::size_t i(0); i < LaneCount; ++i) {
+        const auto &l(r.lanes[i]);
+        auto &stats(retired_[i]);
+        stats.enqueued += l.enqueued.load(std::memory_order_relaxed);
+        stats.dropped += l.dropped.load(std::memory_order_relaxed);
+        stats.high_water = std::max
+            (stats.high_water, l.high_water.load(std::memory_order_relaxed));
+    }
+}
+
+void async_writer::write_stopped(ring *r, const record &rec, bool own)
+{
+    // keep thread's order: lines it queued before go first; they are
+    // drained by the stopping writer or by shutdown() (unless we are the
+    // one draining)
+    if (r && !inWriterThread) {
+        boost::mutex::scoped_lock guard(m_);
+        while (!r->empty()) {
+            done_.timed_wait(guard, boost::posix_time::milliseconds(10));
+        }
+    }
+
+    output_(rec, own);
+}
+
+void async_writer::wakeup()
+{
+    boost::mutex::scoped_lock guard(m_);
+    wakeup_.notify_one();
+}
+
+void async_writer::flush()
+{
+    // writer cannot wait for itself
+    if (inWriterThread) { return; }
+
+    boost::mutex::scoped_lock guard(m_);
+    if (!running_.load()) { return; }
+
+    // keep rings alive, drain() can drop rings of finished threads
+    typedef std::array<std::size_t, LaneCount> tails;
+    std::vector<std::pair<std::shared_ptr<ring>, tails> > targets;
+    targets.reserve(rings_.size());
+    for (const auto &r : rings_) {
+        tails t;
+        for (std::size_t i(0); i < LaneCount; ++i) {
+            t[i] = r->lanes[i].tail.load();
+        }
+        targets.emplace_back(r, t);
+    }
+
+    auto reached([&]() -> bool {
+            for (const auto &target : targets) {
+                for (std::size_t i(0); i < LaneCount; ++i) {
+                    if (target.first->lanes[i].head.load()
+                        < target.second[i])
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        });
+
+    wakeup_.notify_one();
+    while (!reached()) {
+        done_.timed_wait(guard, boost::posix_time::milliseconds(10));
+    }
+}
+
+void async_writer::shutdown()
+{
+    // writer cannot join itself
+    if (inWriterThread) { return; }
+
+    // concurrent callers wait for the first one to finish
+    boost::mutex::scoped_lock shutdownGuard(shutdown_m_);
+    if (!thread_.joinable()) { return; }
+
+    {
+        boost::mutex::scoped_lock guard(m_);
+        running_.store(false);
+        wakeup_.notify_one();
+        // producers waiting for free space write synchronously
+        done_.notify_all();
+    }
+
+    thread_.join();
+
+    // wait for pushes that have seen the writer running, they are short
+    std::vector<std::shared_ptr<ring> > rings;
+    {
+        boost::mutex::scoped_lock guard(m_);
+        rings.assign(rings_.begin(), rings_.end());
+    }
+    for (const auto &r : rings) {
+        while (r->pushing.load()) { boost::this_thread::yield(); }
+    }
+
+    // pick up anything pushed while the writer was stopping; output function
+    // runs here now
+    inWriterThread = true;
+    drain();
+    inWriterThread = false;
+
+    // let synchronous writers waiting for their rings go on
+    boost::mutex::scoped_lock guard(m_);
+    done_.notify_all();
+}
+
+bool async_writer::drain()
+{
+    {
+        boost::mutex::scoped_lock guard(m_);
+        // drop rings of finished threads, they cannot get any new record
+        rings_.erase(std::remove_if(rings_.begin(), rings_.end()
+                                    , [this](const std::shared_ptr<ring> &r)
+                                    {
+                                        if ((r.use_count() > 1)
+                                            || !r->empty())
+                                        {
+                                            return false;
+                                        }
+                                        retire(*r);
+                                        return true;
+                                    })
+                     , rings_.end());
+        drained_.assign(rings_.begin(), rings_.end());
+    }
+
+    bool work(false);
+    for (const auto &r : drained_) {
+        // merge lanes up to records published so far
+        std::size_t heads[LaneCount];
+        std::size_t tails[LaneCount];
+        for (std::size_t i(0); i < LaneCount; ++i) {
+            heads[i] = r->lanes[i].head.load(std::memory_order_relaxed);
+            tails[i] = r->lanes[i].tail.load(std::memory_order_acquire);
+        }
+
+        for (;;) {
+            ring::lane *lane(nullptr);
+            const ring::slot *slot(nullptr);
+            std::size_t *head(nullptr);
+            for (std::size_t i(0); i < LaneCount; ++i) {
+                if (heads[i] == tails[i]) { continue; }
+                auto &l(r->lanes[i]);
+                const auto &s(l.slots[heads[i] % l.capacity]);
+                if (!slot || (s.seq < slot->seq)) {
+                    lane = &l;
+                    slot = &s;
+                    head = &heads[i];
+                }
+            }
+            // record published after we read its lane's tail goes first;
+            // stop here and pick it up on next pass
+            if (!slot || (slot->seq != r->next)) { break; }
+
+            try {
+                scoped_line_stream text;
+                const record rec(*slot, *text);
+                output_(rec, slot->own);
+            } catch (...) {
+                // nowhere to report; never let the writer thread die
+            }
+            ++r->next;
+            lane->head.store(++*head, std::memory_order_release);
+            work = true;
+        }
+    }
+
+    drained_.clear();
+    return work;
+}
+
+void async_writer::run()
+{
+    inWriterThread = true;
+
+    for (;;) {
+        const bool work(drain());
+
+        boost::mutex::scoped_lock guard(m_);
+        if (work) {
+            // notify flushers and producers waiting for free space
+            done_.notify_all();
+            continue;
+        }
+
+        if (!running_.load()) { break; }
+
+        // nothing to do, go to sleep unless somebody managed to push a
+        // record after drain; seq_cst pairs with push()
+        sleeping_.store(true);
+        const bool idle(std::all_of(rings_.begin(), rings_.end()
+                                    , [](const std::shared_ptr<ring> &r)
+                                    {
+                                        return r->empty();
+                                    }));
+        if (idle) {
+            wakeup_.timed_wait(guard, boost::posix_time::milliseconds(100));
+        }
+        sleeping_.store(false);
+    }
+}
+
+} } // namespace dbglog::detail
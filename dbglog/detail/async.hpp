@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_async_hpp_included_
+#define dbglog_detail_async_hpp_included_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "../level.hpp"
+#include "../record.hpp"
+
+namespace dbglog {
+
+/** Severity lanes of asynchronous writer, one per level group.
+ */
+enum class async_lane { debug, info, warn, err, fatal };
+
+/** Per-lane counters of asynchronous writer (summed over all threads).
+ */
+struct async_lane_stats {
+    /** Records queued.
+     */
+    std::uint64_t enqueued;
+
+    /** Records shed because their lane was full.
+     */
+    std::uint64_t dropped;
+
+    /** Maximum number of records ever queued in one thread's lane.
+     */
+    std::size_t high_water;
+};
+
+namespace detail {
+
+/** Asynchronous log line writer.
+ *
+ *  Every producer thread owns its own bounded single-producer/single-consumer
+ *  ring of records; one background thread drains all rings and hands records
+ *  to the output function. Producer side is lock-free unless the ring is full
+ *  or the writer sleeps (then producer wakes it up).
+ *
+ *  Ring is split into lanes by severity (see async_lane), each of them of
+ *  full capacity; writer merges lanes back in order of their records. Debug
+ *  lines filling their lane thus never take space from errors. When a lane
+ *  is full its producer waits for the writer unless record's level is in
+ *  shed mask (never fatal), then the record is dropped.
+ *
+ *  Writer is created stopped and can be started and shut down repeatedly;
+ *  its users keep one instance for their whole lifetime, i.e. producers
+ *  never see it replaced.
+ */
+class async_writer : boost::noncopyable {
+public:
+    /** Output function: record and own flag (whether logger's own outputs
+     *  want the record, decided by the producer).
+     */
+    typedef std::function<void(const record&, bool)> output_type;
+
+    /** Writer is stopped until start() is called.
+     */
+    async_writer(const output_type &output);
+
+    /** Drains all pending records and stops the writer thread.
+     */
+    ~async_writer();
+
+    /** Starts the writer thread; every producer thread gets its own ring of
+     *  capacity records per lane. Records of levels in shed mask are dropped
+     *  when their lane is full. Does nothing if already running (shed mask
+     *  is updated though).
+     */
+    void start(std::size_t capacity, unsigned int shed = none);
+
+    /** Enqueues copy of one record. Blocks only when calling thread's ring
+     *  is full. Writes record synchronously when the writer has been shut
+     *  down (after records this thread queued before).
+     */
+    void push(const record &r, bool own);
+
+    /** Waits until all records pushed (by any thread) before this call are
+     *  written.
+     */
+    void flush();
+
+    /** Drains all pending records and stops the writer thread. Idempotent.
+     *  Writer can be started again afterwards.
+     */
+    void shutdown();
+
+    bool running() const { return running_.load(); }
+
+    /** Returns counters of given lane since the writer has been created
+     *  (summed over all rings).
+     */
+    async_lane_stats stats(async_lane lane) const;
+
+    static const std::size_t LaneCount = 5;
+
+    /** Returns true once the writer has been started (stays true after
+     *  shutdown: producers keep going through push() to keep their order).
+     */
+    bool started() const { return started_.load(); }
+
+    /** Returns true if called from the writer thread (i.e. from inside the
+     *  output function).
+     */
+    static bool in_writer();
+
+    struct ring;
+
+private:
+    /** Returns calling thread's ring (created unless create is false),
+     *  nullptr if there is none.
+     */
+    ring* local(bool create = true);
+
+    /** Writes record synchronously after the writer has stopped; waits
+     *  until calling thread's ring r (if any) is drained first.
+     */
+    void write_stopped(ring *r, const record &rec, bool own);
+
+    void run();
+
+    bool drain();
+
+    void wakeup();
+
+    /** Adds counters of ring r to retired_ before the ring is dropped;
+     *  m_ must be held.
+     */
+    void retire(const ring &r);
+
+    const output_type output_;
+
+    /** Capacity of newly created rings.
+     */
+    std::atomic<std::size_t> capacity_;
+
+    /** Mask of levels that can be shed.
+     */
+    std::atomic<unsigned int> shed_;
+
+    /** Per-lane counters of rings dropped so far, guarded by m_. Live
+     *  rings keep their own counters.
+     */
+    async_lane_stats retired_[LaneCount];
+
+    /** Unique identifier of current run of this writer, used to find
+     *  thread's ring (rings are not reused between runs).
+     */
+    std::atomic<std::uint64_t> id_;
+
+    mutable boost::mutex m_;
+    boost::condition_variable wakeup_;
+    boost::condition_variable done_;
+
+    /** All rings, guarded by m_.
+     */
+    std::vector<std::shared_ptr<ring> > rings_;
+
+    /** Writer's private copy of rings_.
+     */
+    std::vector<std::shared_ptr<ring> > drained_;
+
+    std::atomic<bool> sleeping_;
+    std::atomic<bool> running_;
+    std::atomic<bool> started_;
+
+    /** Serializes start() and shutdown().
+     */
+    boost::mutex shutdown_m_;
+
+    boost::thread thread_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_async_hpp_included_
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "binary.hpp"
+#include "log_helpers.hpp"
+#include "time.hpp"
+
+namespace dbglog { namespace detail {
+
+namespace {
+
+std::atomic<std::uint32_t> callsiteIdGenerator(0);
+
+/** Session numbers are unique across all binary files.
+ */
+std::atomic<std::uint64_t> sessionGenerator(0);
+
+} // namespace
+
+binary_callsite::binary_callsite(const location &loc, level l)
+    : loc(loc), l(l), id(++callsiteIdGenerator), format(nullptr)
+    , session(0)
+{}
+
+binary_file::binary_file()
+    : session_(new std::uint64_t(0))
+{}
+
+bool binary_file::open(const std::string &filename)
+{
+    boost::mutex::scoped_lock guard(openLock_);
+
+    // stop writers and wait for those still writing to the old file
+    if (session_.get()) {
+        session_.publish(std::unique_ptr<std::uint64_t>
+                         (new std::uint64_t(0)));
+    }
+
+    if (filename.empty()) { return log_file(filename); }
+    if (!log_file(filename)) { return false; }
+
+    scoped_line_stream os;
+    binary::put(*os, char(binary::header));
+    os->write(binary::magic, sizeof(binary::magic));
+    binary::put<std::uint32_t>(*os, binary::version);
+    binary::put<std::uint32_t>(*os, processId());
+    const auto &record(os->str());
+    write_file(record.data(), record.size());
+
+    session_.publish(std::unique_ptr<std::uint64_t>
+                     (new std::uint64_t(++sessionGenerator)));
+    return true;
+}
+
+bool binary_file::register_format(binary_callsite &site, const char *format)
+{
+    const char *expected(nullptr);
+    if (site.format.compare_exchange_strong(expected, format)) {
+        return true;
+    }
+    return (expected == format) || !std::strcmp(expected, format);
+}
+
+void binary_file::write_callsite(binary_callsite &site
+                                 , std::uint64_t session)
+{
+    boost::mutex::scoped_lock guard(callsiteLock_);
+    // somebody has been faster
+    if (site.session.load() == session) { return; }
+
+    scoped_line_stream os;
+    binary::put(*os, char(binary::callsite));
+    binary::put<std::uint32_t>(*os, site.id);
+    binary::put<std::uint32_t>(*os, site.l);
+    binary::putString<std::uint16_t>(*os, site.loc.file);
+    binary::putString<std::uint16_t>(*os, site.loc.func);
+    binary::put<std::uint32_t>(*os, std::uint32_t(site.loc.line));
+    binary::putString<std::uint16_t>(*os, site.format.load());
+    const auto &record(os->str());
+    write_file(record.data(), record.size());
+
+    // definition is in the file, entries can follow
+    site.session.store(session, std::memory_order_release);
+}
+
+void binary_file::begin_entry(std::ostream &os, const binary_callsite &site
+                              , const std::string &prefix
+                              , const char *format)
+{
+    // same clock as text lines, full precision
+    const auto now(current_time(9));
+
+    binary::put(os, char(format ? binary::formatEntry : binary::entry));
+    binary::put<std::uint32_t>(os, site.id);
+    binary::put<std::int64_t>(os, now.sec);
+    binary::put<std::uint32_t>(os, now.nsec);
+    binary::putString<std::uint16_t>(os, thread_id::get());
+    binary::putString<std::uint16_t>(os, prefix);
+    if (format) { binary::putString<std::uint16_t>(os, format); }
+}
+
+} } // namespace dbglog::detail
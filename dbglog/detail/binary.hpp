@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_binary_hpp_included_
+#define dbglog_detail_binary_hpp_included_
+
+#include <string>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "../level.hpp"
+#include "../location.hpp"
+#include "../logfile.hpp"
+#include "line_buffer.hpp"
+#include "rcu.hpp"
+
+namespace dbglog { namespace detail {
+
+/** Binary (deferred formatting) log file format.
+ *
+ *  File is a sequence of records, each starting with one byte record type.
+ *  All integers are in host byte order, strings are length-prefixed (no
+ *  terminating NUL).
+ *
+ *  header:   'H' magic[8] u32:version u32:pid
+ *            (written on every open; starts new session: callsite ids are
+ *            valid only up to next header)
+ *  callsite: 'C' u32:id u32:level str16:file str16:func u32:line
+ *            str16:format
+ *  entry:    'E' u32:id i64:sec u32:nsec str16:thread str16:prefix
+ *            u8:argc arg*
+ *  entry with its own format (call site used with another format):
+ *            'F' u32:id i64:sec u32:nsec str16:thread str16:prefix
+ *            str16:format u8:argc arg*
+ *
+ *  arg:      'i' i64 | 'u' u64 | 'd' f64 | 'c' u8 | 'b' u8 | 's' str32
+ *            (other types are stored rendered to text, as 's')
+ */
+namespace binary {
+
+const char magic[8] = { 'D', 'B', 'G', 'L', 'O', 'G', 'B', '\n' };
+const std::uint32_t version(1);
+
+enum record : char {
+    header = 'H', callsite = 'C', entry = 'E', formatEntry = 'F'
+};
+
+enum tag : char {
+    signedInt = 'i', unsignedInt = 'u', floating = 'd'
+    , character = 'c', boolean = 'b', string = 's'
+};
+
+template <typename T>
+inline void put(std::ostream &os, const T &value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename Size>
+inline void putString(std::ostream &os, const char *data, std::size_t size)
+{
+    // longer strings are cut, should not happen for file, function or format
+    if (size > Size(~Size(0))) { size = Size(~Size(0)); }
+    put<Size>(os, Size(size));
+    os.write(data, size);
+}
+
+template <typename Size>
+inline void putString(std::ostream &os, const char *str)
+{
+    putString<Size>(os, str, std::strlen(str));
+}
+
+template <typename Size>
+inline void putString(std::ostream &os, const std::string &str)
+{
+    putString<Size>(os, str.data(), str.size());
+}
+
+/** Argument encoder, default: argument rendered to text.
+ */
+template <typename T, typename Enable = void>
+struct arg {
+    static void encode(std::ostream &os, const T &value) {
+        scoped_line_stream text;
+        *text << value;
+        put(os, char(string));
+        putString<std::uint32_t>(os, text->str());
+    }
+};
+
+template <typename T>
+struct arg<T, typename std::enable_if<std::is_integral<T>::value
+                                      && std::is_signed<T>::value>::type>
+{
+    static void encode(std::ostream &os, T value) {
+        put(os, char(signedInt));
+        put<std::int64_t>(os, value);
+    }
+};
+
+template <typename T>
+struct arg<T, typename std::enable_if<std::is_integral<T>::value
+                                      && std::is_unsigned<T>::value>::type>
+{
+    static void encode(std::ostream &os, T value) {
+        put(os, char(unsignedInt));
+        put<std::uint64_t>(os, value);
+    }
+};
+
+template <typename T>
+struct arg<T, typename std::enable_if
+           <std::is_floating_point<T>::value>::type>
+{
+    static void encode(std::ostream &os, T value) {
+        put(os, char(floating));
+        put<double>(os, value);
+    }
+};
+
+template <> struct arg<char> {
+    static void encode(std::ostream &os, char value) {
+        put(os, char(character));
+        put(os, value);
+    }
+};
+
+template <> struct arg<bool> {
+    static void encode(std::ostream &os, bool value) {
+        put(os, char(boolean));
+        put<std::uint8_t>(os, value);
+    }
+};
+
+template <> struct arg<const char*> {
+    static void encode(std::ostream &os, const char *value) {
+        put(os, char(string));
+        putString<std::uint32_t>(os, value ? value : "(null)");
+    }
+};
+
+template <> struct arg<char*> : arg<const char*> {};
+
+template <> struct arg<std::string> {
+    static void encode(std::ostream &os, const std::string &value) {
+        put(os, char(string));
+        putString<std::uint32_t>(os, value);
+    }
+};
+
+inline void encode(std::ostream&) {}
+
+template <typename T, typename ...Args>
+inline void encode(std::ostream &os, T &&value, Args &&...rest)
+{
+    arg<typename std::decay<T>::type>::encode(os, value);
+    encode(os, std::forward<Args>(rest)...);
+}
+
+} // namespace binary
+
+/** Binary log call site, one static instance per LOGB statement. Its
+ *  description is written to the binary log once per log file session.
+ */
+struct binary_callsite : boost::noncopyable {
+    binary_callsite(const location &loc, level l);
+
+    const location loc;
+    const level l;
+    const std::uint32_t id;
+
+    /** Format registered with this call site (the first one used).
+     */
+    std::atomic<const char*> format;
+
+    /** Binary log session this call site has been written to.
+     */
+    std::atomic<std::uint64_t> session;
+};
+
+/** Binary log file. Records are assembled in calling thread's buffer and
+ *  each one is written by a single write.
+ */
+class binary_file : public logger_file {
+public:
+    binary_file();
+
+    /** Opens binary log file (appends new session), empty filename closes
+     *  it. Thread safe.
+     */
+    bool open(const std::string &filename);
+
+    bool active() const { return *session_reader(session_) != 0; }
+
+    template <typename ...Args>
+    void write(binary_callsite &site, const std::string &prefix
+               , const char *format, Args &&...args)
+    {
+        // file cannot be switched while we are in the read section
+        session_reader s(session_);
+        const auto session(*s);
+        if (!session) { return; }
+
+        const bool own(register_format(site, format));
+        if (site.session.load(std::memory_order_acquire) != session) {
+            write_callsite(site, session);
+        }
+
+        scoped_line_stream os;
+        begin_entry(*os, site, prefix, own ? nullptr : format);
+        binary::put<std::uint8_t>(*os, std::uint8_t(sizeof...(Args)));
+        binary::encode(*os, std::forward<Args>(args)...);
+
+        const auto &record(os->str());
+        write_file(record.data(), record.size());
+    }
+
+private:
+    typedef rcu_ptr<std::uint64_t>::reader session_reader;
+
+    /** Registers format with call site, returns false if site already has
+     *  different format.
+     */
+    static bool register_format(binary_callsite &site, const char *format);
+
+    void write_callsite(binary_callsite &site, std::uint64_t session);
+
+    void begin_entry(std::ostream &os, const binary_callsite &site
+                     , const std::string &prefix, const char *format);
+
+    /** Current session number, 0 if no file is open. Writers hold a read
+     *  section; open() publishes 0 (waiting for writers of the old file)
+     *  before switching files.
+     */
+    rcu_ptr<std::uint64_t> session_;
+
+    /** Serializes open() (i.e. session publishers).
+     */
+    boost::mutex openLock_;
+
+    /** Serializes call site registration.
+     */
+    boost::mutex callsiteLock_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_binary_hpp_included_
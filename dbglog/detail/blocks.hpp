@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_blocks_hpp_included_
+#define dbglog_detail_blocks_hpp_included_
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+
+#include <boost/noncopyable.hpp>
+
+#include "time.hpp"
+
+namespace dbglog { namespace detail {
+
+/** Block compressed log file format (see logger_file::log_file_blocks).
+ *
+ *  Log file is a sequence of gzip members, each one holding a block of
+ *  whole lines. Members are independent, i.e. any block can be
+ *  decompressed starting at its offset, and the file as a whole is a valid
+ *  gzip file.
+ *
+ *  Sidecar index (log file name + ".idx") describes the blocks:
+ *
+ *  header:   magic[8] u32:version
+ *  entry:    u64:offset u32:size u32:rawSize i64:sec u32:nsec u32:levels
+ *
+ *  offset and size locate the gzip member in log file, rawSize is length
+ *  of its uncompressed lines, sec/nsec is time of its first line and
+ *  levels is bitwise OR of levels of all its lines (0 for raw data). All
+ *  integers are in host byte order.
+ */
+namespace blocks {
+
+const char magic[8] = { 'D', 'B', 'G', 'L', 'O', 'G', 'X', '\n' };
+const std::uint32_t version(1);
+
+const char indexSuffix[] = ".idx";
+
+const std::size_t headerSize(sizeof(magic) + sizeof(std::uint32_t));
+
+struct entry {
+    std::uint64_t offset;
+    std::uint32_t size;
+    std::uint32_t rawSize;
+    timestamp time;
+    std::uint32_t levels;
+
+    static const std::size_t encodedSize = 32;
+
+    /** Serializes entry into buffer of encodedSize bytes.
+     */
+    void encode(char *out) const {
+        std::memcpy(out, &offset, 8);
+        std::memcpy(out + 8, &size, 4);
+        std::memcpy(out + 12, &rawSize, 4);
+        std::memcpy(out + 16, &time.sec, 8);
+        std::memcpy(out + 24, &time.nsec, 4);
+        std::memcpy(out + 28, &levels, 4);
+    }
+
+    /** Deserializes entry from buffer of encodedSize bytes.
+     */
+    void decode(const char *in) {
+        std::memcpy(&offset, in, 8);
+        std::memcpy(&size, in + 8, 4);
+        std::memcpy(&rawSize, in + 12, 4);
+        std::memcpy(&time.sec, in + 16, 8);
+        std::memcpy(&time.nsec, in + 24, 4);
+        std::memcpy(&levels, in + 28, 4);
+    }
+};
+
+} // namespace blocks
+
+/** Compresses blocks of lines into gzip members and back.
+ */
+class block_compressor : boost::noncopyable {
+public:
+    /** Returns new compressor or nullptr if compression is not available
+     *  (built without zlib).
+     */
+    static std::unique_ptr<block_compressor> create();
+
+    ~block_compressor();
+
+    /** Compresses data into single gzip member stored in out. Returns false
+     *  on failure.
+     */
+    bool compress(const char *data, std::size_t size, std::string &out);
+
+    /** Decompresses single gzip member into out. Returns false if data are
+     *  not valid (or not complete) gzip member or if not available.
+     */
+    static bool decompress(const char *data, std::size_t size
+                           , std::string &out);
+
+    struct stream;
+
+private:
+    explicit block_compressor(std::unique_ptr<stream> &&stream);
+
+    std::unique_ptr<stream> stream_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_blocks_hpp_included_
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_compress_hpp_included_
+#define dbglog_detail_compress_hpp_included_
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include <sys/types.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+namespace dbglog { namespace detail {
+
+/** Compresses rotated log file generations (filename.N -> filename.N.gz)
+ *  in a low priority background thread and prunes the oldest generations
+ *  to fit into byte budget.
+ *
+ *  Input is read at most rate bytes per second to spread disk load. The
+ *  thread never takes the logger's locks; generations are renamed only
+ *  under the shared generation lock, which rotation holds while shifting
+ *  generations. Compressed data are written to filename.gz.tmp first and
+ *  the result is put in place of the generation wherever it has moved
+ *  meanwhile (or dropped if it has been removed).
+ */
+class compressor : boost::noncopyable {
+public:
+    /** Returns new compressor or nullptr if compression is not available
+     *  (built without zlib).
+     */
+    static std::unique_ptr<compressor> create(boost::mutex &generationLock);
+
+    ~compressor();
+
+    /** Sets read rate limit in bytes per second (0: unlimited) and total
+     *  size of all generations (0: unlimited).
+     */
+    void limits(std::uint64_t rate, std::uint64_t budget);
+
+    /** Tells the compressor about current generations: filename.1 up to
+     *  filename.keep; wakes it up.
+     */
+    void notify(const std::string &filename, ::mode_t mode
+                , unsigned int keep);
+
+    /** Stops the compressor, unfinished file is left uncompressed.
+     *  Idempotent.
+     */
+    void stop();
+
+private:
+    explicit compressor(boost::mutex &generationLock);
+
+    void run();
+
+    /** Snapshot of settings taken by the worker.
+     */
+    struct settings {
+        std::string filename;
+        ::mode_t mode;
+        unsigned int keep;
+        std::uint64_t rate;
+        std::uint64_t budget;
+    };
+
+    /** Returns current settings or false if stopping.
+     */
+    bool current(settings &s);
+
+    /** Compresses the oldest uncompressed generation. Returns false if
+     *  there is none (or compressor is stopping).
+     */
+    bool compress_one(const settings &s);
+
+    /** Removes the oldest generations over budget.
+     */
+    void prune(const settings &s);
+
+    /** Returns false once stopping.
+     */
+    bool running();
+
+    /** Sleeps until given time or stop; returns false on stop.
+     */
+    bool pace(const boost::posix_time::ptime &until);
+
+    boost::mutex &generationLock_;
+
+    boost::mutex m_;
+    boost::condition_variable wakeup_;
+
+    settings settings_;
+
+    /** Set by notify/limits, cleared by the worker when it starts scanning.
+     */
+    bool pending_;
+    bool running_;
+    boost::thread worker_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_compress_hpp_included_
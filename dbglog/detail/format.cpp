@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstring>
+#include <memory>
+#include <algorithm>
+
+#include "format.hpp"
+
+namespace dbglog { namespace detail {
+
+namespace {
+
+const std::ios_base::fmtflags defaultFlags
+    (std::ios_base::skipws | std::ios_base::dec);
+
+inline bool isDigit(char c) { return (c >= '0') && (c <= '9'); }
+
+std::size_t parseNumber(const char *&p)
+{
+    std::size_t value(0);
+    while (isDigit(*p)) { value = value * 10 + (*p++ - '0'); }
+    return value;
+}
+
+} // namespace
+
+void parsed_format::parse(const char *format)
+{
+    count = 0;
+    args = 0;
+    width = false;
+    fallback = true;
+
+    // positional (%N%) and sequential directives must not be mixed
+    bool positional(false), sequential(false);
+    int next(0);
+
+    const char *p(format);
+    std::size_t textStart(0);
+
+    auto add([&](const char *textEnd, int arg) -> directive* {
+            if (count == MaxDirectives) { return nullptr; }
+            auto &d(directives[count++]);
+            d.textStart = textStart;
+            d.textSize = (textEnd - format) - textStart;
+            d.arg = arg;
+            d.flags = defaultFlags;
+            d.width = 0;
+            d.precision = -1;
+            d.fill = ' ';
+            if (arg >= 0) { args = std::max(args, std::size_t(arg + 1)); }
+            return &d;
+        });
+
+    while (*p) {
+        if (*p != '%') { ++p; continue; }
+        const char *start(p++);
+
+        if (*p == '%') {
+            // literal percent sign: keep first one in text
+            if (!add(p, -1)) { return; }
+            textStart = ++p - format;
+            continue;
+        }
+
+        // positional %N%
+        {
+            const char *q(p);
+            const auto index(parseNumber(q));
+            if ((q != p) && ((*q == '%') || (*q == '$'))) {
+                if ((*q == '$') || !index || sequential) { return; }
+                positional = true;
+                if (!add(start, int(index - 1))) { return; }
+                p = q + 1;
+                textStart = p - format;
+                continue;
+            }
+        }
+
+        if (positional) { return; }
+        sequential = true;
+
+        auto *d(add(start, next++));
+        if (!d) { return; }
+
+        // flags
+        bool left(false), zero(false);
+        for (;; ++p) {
+            switch (*p) {
+            case '-': left = true; continue;
+            case '0': zero = true; continue;
+            case '+': d->flags |= std::ios_base::showpos; continue;
+            case '#':
+                d->flags |= (std::ios_base::showbase
+                             | std::ios_base::showpoint);
+                continue;
+            default: break;
+            }
+            break;
+        }
+
+        if (left) {
+            d->flags |= std::ios_base::left;
+        } else if (zero) {
+            d->flags |= std::ios_base::internal;
+            d->fill = '0';
+        }
+
+        if (isDigit(*p)) {
+            d->width = parseNumber(p);
+            width = true;
+        }
+
+        if (*p == '.') {
+            ++p;
+            d->precision = parseNumber(p);
+        }
+
+        // length modifiers are meaningless for streams
+        while (std::strchr("hlLqjzt", *p) && *p) { ++p; }
+
+        const bool precision(d->precision >= 0);
+        switch (*p) {
+        case 's': case 'S':
+            if (precision) { return; } // truncation
+            break;
+
+        case 'd': case 'i': case 'u':
+            if (precision) { return; }
+            break;
+
+        case 'x': case 'X':
+            if (precision) { return; }
+            d->flags = (d->flags & ~std::ios_base::basefield)
+                | std::ios_base::hex;
+            if (*p == 'X') { d->flags |= std::ios_base::uppercase; }
+            break;
+
+        case 'o':
+            if (precision) { return; }
+            d->flags = (d->flags & ~std::ios_base::basefield)
+                | std::ios_base::oct;
+            break;
+
+        case 'e': case 'E':
+            d->flags |= std::ios_base::scientific;
+            if (*p == 'E') { d->flags |= std::ios_base::uppercase; }
+            break;
+
+        case 'f': case 'F':
+            d->flags |= std::ios_base::fixed;
+            break;
+
+        case 'g': case 'G':
+            if (*p == 'G') { d->flags |= std::ios_base::uppercase; }
+            break;
+
+        default:
+            // %c, %p, %|...|, '*' width etc. are left to Boost.Format
+            return;
+        }
+
+        textStart = ++p - format;
+    }
+
+    // trailing text
+    if (!add(p, -1)) { return; }
+    fallback = false;
+}
+
+const parsed_format& cachedFormat(std::atomic<const parsed_format*> &cache
+                                  , const char *format
+                                  , parsed_format &tmp)
+{
+    if (const auto *cached = cache.load(std::memory_order_acquire)) {
+        if (cached->key == format) { return *cached; }
+        // call site used with another format
+        tmp.parse(format);
+        return tmp;
+    }
+
+    std::unique_ptr<parsed_format> parsed(new parsed_format());
+    parsed->parse(format);
+    parsed->key = format;
+
+    const parsed_format *expected(nullptr);
+    if (cache.compare_exchange_strong(expected, parsed.get()
+                                      , std::memory_order_acq_rel))
+    {
+        return *parsed.release();
+    }
+
+    // another thread was faster
+    if (expected->key == format) { return *expected; }
+    tmp.parse(format);
+    return tmp;
+}
+
+} } // namespace dbglog::detail
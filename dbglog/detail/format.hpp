@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef dbglog_detail_format_hpp_included_
+#define dbglog_detail_format_hpp_included_
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include <boost/format.hpp>
+
+namespace dbglog { namespace detail {
+
+inline void formatMessage(boost::format&) {}
+
+template <typename T, typename ...Args>
+inline void formatMessage(boost::format &fmt, T &&arg, Args &&...rest)
+{
+    fmt % arg;
+    return formatMessage(fmt, std::forward<Args>(rest)...);
+}
+
+/** Formats message using Boost.Format, format errors are ignored.
+ */
+template <typename ...Args>
+inline void boostFormatTo(std::ostream &os, const char *format
+                          , Args &&...args)
+{
+    boost::format fmt(format);
+    fmt.exceptions(boost::io::no_error_bits);
+    formatMessage(fmt, std::forward<Args>(args)...);
+    os << fmt;
+}
+
+/** Format string (Boost.Format syntax) parsed into literal text and
+ *  directives, written directly into output stream without Boost.Format.
+ *
+ *  Handles printf-like directives (%d, %5.2f, %-10s, %#x, %%...) and
+ *  positional %N% ones, i.e. what Boost.Format does by setting stream flags
+ *  and streaming the argument. Anything else (e.g. %c, %.3s truncation,
+ *  %|...| or too many directives) sets fallback and Boost.Format is used.
+ */
+struct parsed_format {
+    /** Literal text followed by one argument.
+     */
+    struct directive {
+        std::size_t textStart;
+        std::size_t textSize;
+
+        /** Argument index, -1 for trailing text.
+         */
+        int arg;
+
+        std::ios_base::fmtflags flags;
+        std::streamsize width;
+        std::streamsize precision; //!< -1 = stream's default
+        char fill;
+    };
+
+    static const std::size_t MaxDirectives = 32;
+
+    parsed_format() : key(nullptr), count(0), args(0), width(false)
+                    , fallback(true) {}
+
+    /** Parses format; sets fallback if not supported.
+     */
+    void parse(const char *format);
+
+    /** Format the result has been parsed from (cached formats only).
+     */
+    const char *key;
+
+    directive directives[MaxDirectives];
+    std::size_t count;
+
+    /** Number of arguments format refers to.
+     */
+    std::size_t args;
+
+    /** Some directive sets width.
+     */
+    bool width;
+
+    bool fallback;
+};
+
+/** Returns format parsed once per call site: cache holds format parsed on
+ *  first use (keyed by its address, formats are literals). Different
+ *  format at the same call site is parsed into tmp.
+ */
+const parsed_format& cachedFormat(std::atomic<const parsed_format*> &cache
+                                  , const char *format
+                                  , parsed_format &tmp);
+
+namespace format_detail {
+
+typedef void (*arg_writer)(std::ostream &os, const void *arg);
+
+template <typename T>
+void writeArg(std::ostream &os, const void *arg)
+{
+    os << *static_cast<const T*>(arg);
+}
+
+/** Types padded correctly by stream width, i.e. without multiple inserts.
+ */
+template <typename T>
+struct padded : std::integral_constant
+    <bool, (std::is_arithmetic<T>::value
+            || std::is_same<T, std::string>::value
+            || std::is_same<T, const char*>::value
+            || std::is_same<T, char*>::value
+            || (std::is_array<T>::value
+                && std::is_same<typename std::remove_cv
+                   <typename std::remove_extent<T>::type>::type
+                   , char>::value))>
+{};
+
+template <typename ...Args> struct all_padded;
+
+template <> struct all_padded<> : std::true_type {};
+
+template <typename T, typename ...Args>
+struct all_padded<T, Args...>
+    : std::integral_constant<bool, (padded<T>::value
+                                    && all_padded<Args...>::value)>
+{};
+
+} // namespace format_detail
+
+/** Writes arguments formatted by parsed format. Missing arguments are left
+ *  out, superfluous ones are ignored (as Boost.Format with no error bits).
+ */
+template <typename ...Args>
+inline void formatTo(std::ostream &os, const parsed_format &p
+                     , const char *format, Args &&...args)
+{
+    typedef format_detail::arg_writer arg_writer;
+    if (p.fallback
+        || (p.width && !format_detail::all_padded
+            <typename std::decay<Args>::type...>::value))
+    {
+        boostFormatTo(os, format, std::forward<Args>(args)...);
+        return;
+    }
+
+    // first element is dummy to allow empty argument list
+    const void *values[] = { nullptr, &args... };
+    const arg_writer writers[] = {
+        nullptr
+        , &format_detail::writeArg
+        <typename std::remove_reference<Args>::type>...
+    };
+    const int argc(sizeof...(Args));
+
+    for (std::size_t i(0); i < p.count; ++i) {
+        const auto &d(p.directives[i]);
+        os.write(format + d.textStart, d.textSize);
+        if ((d.arg < 0) || (d.arg >= argc)) { continue; }
+
+        const auto flags(os.flags());
+        const auto precision(os.precision());
+        const auto fill(os.fill());
+
+        os.flags(d.flags);
+        if (d.precision >= 0) { os.precision(d.precision); }
+        os.fill(d.fill);
+        os.width(d.width);
+        writers[d.arg + 1](os, values[d.arg + 1]);
+
+        os.width(0);
+        os.fill(fill);
+        os.precision(precision);
+        os.flags(flags);
+    }
+}
+
+/** Formats message, format is parsed on every call.
+ */
+template <typename ...Args>
+inline void formatTo(std::ostream &os, const char *format, Args &&...args)
+{
+    parsed_format p;
+    p.parse(format);
+    formatTo(os, p, format, std::forward<Args>(args)...);
+}
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_format_hpp_included_
@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef dbglog_detail_limit_hpp_included_
+#define dbglog_detail_limit_hpp_included_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+namespace dbglog { namespace detail {
+
+/** Result of rate limiter check.
+ */
+struct limit_check {
+    bool pass;
+
+    /** Number of statements suppressed since last pass, reported with line.
+     */
+    std::uint64_t suppressed;
+};
+
+inline std::int64_t limit_now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** LOG_EVERY_N: lets through 1st, (n+1)th, (2n+1)th... statement.
+ */
+class every_n_limiter {
+public:
+    constexpr every_n_limiter() : count_(0) {}
+
+    limit_check check(std::uint64_t n) {
+        if (n <= 1) { return { true, 0 }; }
+        const auto count(count_.fetch_add(1, std::memory_order_relaxed));
+        if (count % n) { return { false, 0 }; }
+        return { true, count ? (n - 1) : 0 };
+    }
+
+private:
+    std::atomic<std::uint64_t> count_;
+};
+
+/** LOG_FIRST_N: lets through first n statements.
+ */
+class first_n_limiter {
+public:
+    constexpr first_n_limiter() : count_(0) {}
+
+    limit_check check(std::uint64_t n) {
+        // stop counting once over the limit, counter never wraps
+        if (count_.load(std::memory_order_relaxed) >= n) {
+            return { false, 0 };
+        }
+        return { count_.fetch_add(1, std::memory_order_relaxed) < n, 0 };
+    }
+
+private:
+    std::atomic<std::uint64_t> count_;
+};
+
+/** LOG_EVERY_T: lets through at most one statement per given period.
+ */
+class every_t_limiter {
+public:
+    constexpr every_t_limiter() : next_(0), suppressed_(0) {}
+
+    limit_check check(double seconds) {
+        const auto now(limit_now());
+        auto next(next_.load(std::memory_order_relaxed));
+        if ((next && (now < next))
+            || !next_.compare_exchange_strong
+            (next, now + std::int64_t(seconds * 1e9)
+             , std::memory_order_relaxed))
+        {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return { false, 0 };
+        }
+        return { true, suppressed_.exchange(0, std::memory_order_relaxed) };
+    }
+
+private:
+    /** Time (steady clock, ns) of next allowed statement, 0 = any time.
+     */
+    std::atomic<std::int64_t> next_;
+    std::atomic<std::uint64_t> suppressed_;
+};
+
+/** LOG_RATE: token bucket of burst tokens refilled at perSecond tokens per
+ *  second. Implemented as generic cell rate algorithm, i.e. the whole bucket
+ *  is a single "theoretical arrival time" updated by CAS.
+ */
+class rate_limiter {
+public:
+    constexpr rate_limiter() : tat_(0), suppressed_(0) {}
+
+    limit_check check(double perSecond, unsigned int burst) {
+        if ((perSecond <= 0.0) || !burst) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return { false, 0 };
+        }
+
+        const std::int64_t interval(std::max(std::int64_t(1e9 / perSecond)
+                                             , std::int64_t(1)));
+        const std::int64_t tolerance(interval * (burst - 1));
+        const auto now(limit_now());
+
+        auto tat(tat_.load(std::memory_order_relaxed));
+        for (;;) {
+            const auto start(std::max(tat, now));
+            if ((start - now) > tolerance) {
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return { false, 0 };
+            }
+            if (tat_.compare_exchange_weak(tat, start + interval
+                                           , std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        return { true, suppressed_.exchange(0, std::memory_order_relaxed) };
+    }
+
+private:
+    /** Theoretical arrival time (steady clock, ns) of next statement if the
+     *  bucket were drained at constant rate.
+     */
+    std::atomic<std::int64_t> tat_;
+    std::atomic<std::uint64_t> suppressed_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_limit_hpp_included_
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include "line_buffer.hpp"
+
+namespace dbglog { namespace detail {
+
+namespace {
+
+/** Set once calling thread's pool is destroyed.
+ */
+thread_local bool poolGone(false);
+
+/** Per-thread pool of line streams.
+ */
+struct line_stream_pool : boost::noncopyable {
+    ~line_stream_pool() { poolGone = true; }
+
+    line_stream* acquire() {
+        if (free.empty()) {
+            all.emplace_back(new line_stream());
+            free.reserve(all.size());
+            return all.back().get();
+        }
+        auto *s(free.back());
+        free.pop_back();
+        return s;
+    }
+
+    void release(line_stream *s) { free.push_back(s); }
+
+    std::vector<std::unique_ptr<line_stream> > all;
+    std::vector<line_stream*> free;
+};
+
+thread_local line_stream_pool pool;
+
+} // namespace
+
+scoped_line_stream::scoped_line_stream()
+    : s_()
+{
+    if (poolGone) {
+        owned_.reset(new line_stream());
+        s_ = owned_.get();
+    } else {
+        s_ = pool.acquire();
+    }
+    s_->reset();
+}
+
+scoped_line_stream::~scoped_line_stream()
+{
+    if (!owned_) {
+        s_->trim();
+        pool.release(s_);
+    }
+}
+
+} } // namespace dbglog::detail
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_line_buffer_hpp_included_
+#define dbglog_detail_line_buffer_hpp_included_
+
+#include <string>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <cstring>
+
+#include <boost/noncopyable.hpp>
+
+namespace dbglog { namespace detail {
+
+/** Stream buffer accumulating output in a string that is not shrunk below
+ *  MaxKeep, i.e. once the buffer has grown to the longest (usual) line no
+ *  more allocation occurs. Short writes go to a fixed put area first.
+ */
+class line_buffer : public std::streambuf, boost::noncopyable {
+public:
+    line_buffer() {
+        str_.reserve(256);
+        reset_put_area();
+    }
+
+    /** Returns accumulated text.
+     */
+    const std::string& str() {
+        sync_put_area();
+        return str_;
+    }
+
+    /** Forgets accumulated text, keeps allocated memory.
+     */
+    void clear() {
+        str_.clear();
+        reset_put_area();
+    }
+
+    /** Forgets accumulated text, frees memory grown over MaxKeep: one huge
+     *  line must not pin its memory for the rest of thread's life.
+     */
+    void trim() {
+        if (str_.capacity() > MaxKeep) {
+            std::string().swap(str_);
+            str_.reserve(256);
+        }
+        clear();
+    }
+
+    static const std::size_t MaxKeep = 64 << 10;
+
+protected:
+    virtual int_type overflow(int_type c) {
+        sync_put_area();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual std::streamsize xsputn(const char *s, std::streamsize n) {
+        if (n <= (epptr() - pptr())) {
+            std::memcpy(pptr(), s, n);
+            pbump(int(n));
+            return n;
+        }
+
+        sync_put_area();
+        str_.append(s, n);
+        return n;
+    }
+
+    virtual int sync() {
+        sync_put_area();
+        return 0;
+    }
+
+private:
+    void sync_put_area() {
+        str_.append(pbase(), pptr());
+        reset_put_area();
+    }
+
+    void reset_put_area() { setp(chunk_, chunk_ + sizeof(chunk_)); }
+
+    std::string str_;
+    char chunk_[128];
+};
+
+/** Output stream over line_buffer.
+ */
+class line_stream : public std::ostream {
+public:
+    line_stream() : std::ostream(&buf_) {}
+
+    /** Prepares stream for new line: empty buffer, default formatting.
+     */
+    void reset() {
+        buf_.clear();
+        clear();
+        flags(std::ios_base::skipws | std::ios_base::dec);
+        precision(6);
+        width(0);
+        fill(' ');
+    }
+
+    const std::string& str() { return buf_.str(); }
+
+    /** Called when stream goes back to the pool, see line_buffer::trim.
+     */
+    void trim() { buf_.trim(); }
+
+private:
+    line_buffer buf_;
+};
+
+/** Borrows one of calling thread's reusable line streams for its lifetime.
+ *  Nested uses (e.g. logging from inside operator<<) get their own streams.
+ */
+class scoped_line_stream : boost::noncopyable {
+public:
+    scoped_line_stream();
+    ~scoped_line_stream();
+
+    line_stream& operator*() { return *s_; }
+    line_stream* operator->() { return s_; }
+
+private:
+    line_stream *s_;
+
+    /** Set when thread's pool is already gone (thread exit).
+     */
+    std::unique_ptr<line_stream> owned_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_line_buffer_hpp_included_
@@ -99,6 +99,7 @@ private:
 } // namespace detail
 
 inline std::ostream& operator<<(std::ostream &os, const dbglog::location &l) {
+    if (l.formatted) { return os.write(l.formatted, l.formattedSize); }
     return os << '{' << l.file << ':' << l.func << "():" << l.line << '}';
 }
 
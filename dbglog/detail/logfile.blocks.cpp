@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include <iostream>
+
+#ifdef DBGLOG_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include "blocks.hpp"
+
+namespace dbglog { namespace detail {
+
+#ifndef DBGLOG_HAS_ZLIB
+
+struct block_compressor::stream {};
+
+std::unique_ptr<block_compressor> block_compressor::create()
+{
+    return {};
+}
+
+block_compressor::~block_compressor() {}
+
+bool block_compressor::compress(const char*, std::size_t, std::string&)
+{
+    return false;
+}
+
+bool block_compressor::decompress(const char*, std::size_t, std::string&)
+{
+    return false;
+}
+
+#else
+
+namespace {
+
+/** Compression level: blocks are compressed by logging threads, speed
+ *  matters more than the last few percent of ratio.
+ */
+const int Level(Z_BEST_SPEED);
+
+/** windowBits + 16: gzip wrapper
+ */
+const int GzipWindowBits(15 + 16);
+
+} // namespace
+
+struct block_compressor::stream {
+    ::z_stream z;
+
+    stream() { std::memset(&z, 0, sizeof(z)); }
+    ~stream() { ::deflateEnd(&z); }
+};
+
+std::unique_ptr<block_compressor> block_compressor::create()
+{
+    std::unique_ptr<stream> s(new stream());
+    if (::deflateInit2(&s->z, Level, Z_DEFLATED, GzipWindowBits, 8
+                       , Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        std::cerr << "Error initializing zlib." << std::endl;
+        return {};
+    }
+
+    return std::unique_ptr<block_compressor>
+        (new block_compressor(std::move(s)));
+}
+
+block_compressor::block_compressor(std::unique_ptr<stream> &&stream)
+    : stream_(std::move(stream))
+{}
+
+block_compressor::~block_compressor() {}
+
+bool block_compressor::compress(const char *data, std::size_t size
+                                , std::string &out)
+{
+    auto &z(stream_->z);
+    // every block is a gzip member of its own
+    ::deflateReset(&z);
+
+    out.resize(::deflateBound(&z, size));
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    z.avail_in = size;
+    z.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    z.avail_out = out.size();
+
+    // output buffer is big enough to finish in one go
+    if (::deflate(&z, Z_FINISH) != Z_STREAM_END) {
+        out.clear();
+        return false;
+    }
+
+    out.resize(out.size() - z.avail_out);
+    return true;
+}
+
+bool block_compressor::decompress(const char *data, std::size_t size
+                                  , std::string &out)
+{
+    ::z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    if (::inflateInit2(&z, GzipWindowBits) != Z_OK) { return false; }
+
+    out.clear();
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    z.avail_in = size;
+
+    char buffer[64 << 10];
+    int res(Z_OK);
+    while (res == Z_OK) {
+        z.next_out = reinterpret_cast<Bytef*>(buffer);
+        z.avail_out = sizeof(buffer);
+        res = ::inflate(&z, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - z.avail_out);
+    }
+    ::inflateEnd(&z);
+
+    return (res == Z_STREAM_END);
+}
+
+#endif // DBGLOG_HAS_ZLIB
+
+} } // namespace dbglog::detail
@@ -0,0 +1,364 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <iostream>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef DBGLOG_HAS_ZLIB
+#include <zlib.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "compress.hpp"
+#include "blocks.hpp"
+#include "../logfile.hpp"
+
+namespace dbglog { namespace detail {
+
+#ifndef DBGLOG_HAS_ZLIB
+
+std::unique_ptr<compressor> compressor::create(boost::mutex&)
+{
+    return {};
+}
+
+compressor::~compressor() {}
+void compressor::limits(std::uint64_t, std::uint64_t) {}
+void compressor::notify(const std::string&, ::mode_t, unsigned int) {}
+void compressor::stop() {}
+
+#else
+
+namespace {
+
+/** Read chunk size, also pacing granularity.
+ */
+const std::size_t ChunkSize(64 << 10);
+
+std::string generation(const std::string &filename, unsigned int index)
+{
+    return filename + "." + std::to_string(index);
+}
+
+std::uint64_t fileSize(const std::string &path)
+{
+    struct ::stat st;
+    return (::stat(path.c_str(), &st) == 0) ? st.st_size : 0;
+}
+
+/** Lowers CPU and I/O priority of calling thread. Only Linux has per
+ *  thread priorities; elsewhere the whole process would be affected.
+ */
+void lowerPriority()
+{
+#ifdef __linux__
+    const auto tid(::syscall(SYS_gettid));
+    ::setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+    // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+    ::syscall(SYS_ioprio_set, 1, tid, 3 << 13);
+#endif
+#endif
+}
+
+bool writeAll(int fd, const unsigned char *data, std::size_t size)
+{
+    while (size) {
+        const auto written(TEMP_FAILURE_RETRY(::write(fd, data, size)));
+        if (-1 == written) { return false; }
+        size -= written;
+        data += written;
+    }
+    return true;
+}
+
+} // namespace
+
+std::unique_ptr<compressor> compressor::create(boost::mutex &generationLock)
+{
+    return std::unique_ptr<compressor>(new compressor(generationLock));
+}
+
+compressor::compressor(boost::mutex &generationLock)
+    : generationLock_(generationLock)
+    , settings_{std::string(), DefaultMode, 0, 0, 0}
+    , pending_(false), running_(true)
+{
+    worker_ = boost::thread(&compressor::run, this);
+}
+
+compressor::~compressor()
+{
+    stop();
+}
+
+void compressor::limits(std::uint64_t rate, std::uint64_t budget)
+{
+    boost::mutex::scoped_lock guard(m_);
+    settings_.rate = rate;
+    settings_.budget = budget;
+    pending_ = true;
+    wakeup_.notify_all();
+}
+
+void compressor::notify(const std::string &filename, ::mode_t mode
+                        , unsigned int keep)
+{
+    boost::mutex::scoped_lock guard(m_);
+    settings_.filename = filename;
+    settings_.mode = mode;
+    settings_.keep = keep;
+    pending_ = true;
+    wakeup_.notify_all();
+}
+
+void compressor::stop()
+{
+    {
+        boost::mutex::scoped_lock guard(m_);
+        running_ = false;
+        wakeup_.notify_all();
+    }
+
+    if (worker_.joinable()) { worker_.join(); }
+}
+
+bool compressor::current(settings &s)
+{
+    boost::mutex::scoped_lock guard(m_);
+    s = settings_;
+    return running_;
+}
+
+bool compressor::running()
+{
+    boost::mutex::scoped_lock guard(m_);
+    return running_;
+}
+
+bool compressor::pace(const boost::posix_time::ptime &until)
+{
+    boost::mutex::scoped_lock guard(m_);
+    while (running_
+           && (boost::posix_time::microsec_clock::universal_time() < until))
+    {
+        wakeup_.timed_wait(guard, until);
+    }
+    return running_;
+}
+
+void compressor::run()
+{
+    lowerPriority();
+
+    boost::mutex::scoped_lock guard(m_);
+    while (running_) {
+        while (running_ && !pending_) { wakeup_.wait(guard); }
+        if (!running_) { break; }
+        pending_ = false;
+
+        guard.unlock();
+        settings s;
+        while (current(s) && compress_one(s)) { prune(s); }
+        if (current(s)) { prune(s); }
+        guard.lock();
+    }
+}
+
+bool compressor::compress_one(const settings &s)
+{
+    if (s.filename.empty() || !s.keep) { return false; }
+
+    // oldest generation first: it is the first one to be pruned, and it is
+    // pruned compressed
+    int src(-1);
+    {
+        boost::mutex::scoped_lock guard(generationLock_);
+        for (auto i(s.keep); (i >= 1) && (-1 == src); --i) {
+            const auto path(generation(s.filename, i));
+            // block output is compressed already
+            if (!::access((path + blocks::indexSuffix).c_str(), F_OK)) {
+                continue;
+            }
+            src = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+    }
+    if (-1 == src) { return false; }
+
+    struct ::stat st;
+    const auto tmp(s.filename + ".gz.tmp");
+    int dst(-1);
+    if ((-1 == ::fstat(src, &st))
+        || (-1 == (dst = ::open(tmp.c_str()
+                                , O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC
+                                , s.mode))))
+    {
+        const auto error(errno);
+        ::close(src);
+        std::cerr << "Error compressing log file <" << s.filename
+                  << ">: " << error << std::endl;
+        return false;
+    }
+
+    ::z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    // windowBits + 16: gzip wrapper
+    if (::deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8
+                       , Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        std::cerr << "Error initializing zlib." << std::endl;
+        ::close(dst);
+        ::close(src);
+        ::unlink(tmp.c_str());
+        return false;
+    }
+
+    std::vector<unsigned char> in(ChunkSize), out(ChunkSize);
+    const auto start(boost::posix_time::microsec_clock::universal_time());
+    std::uint64_t total(0);
+    bool ok(true), stopped(false);
+    // errno of failed call, saved before anything else can overwrite it
+    int error(0);
+
+    for (int flush(Z_NO_FLUSH); ok && (flush != Z_FINISH); ) {
+        const auto r(TEMP_FAILURE_RETRY(::read(src, in.data(), in.size())));
+        if (-1 == r) {
+            error = errno;
+            ok = false;
+            break;
+        }
+
+        flush = (r ? Z_NO_FLUSH : Z_FINISH);
+        z.next_in = in.data();
+        z.avail_in = r;
+        do {
+            z.next_out = out.data();
+            z.avail_out = out.size();
+            ::deflate(&z, flush);
+            ok = writeAll(dst, out.data(), out.size() - z.avail_out);
+            if (!ok) { error = errno; }
+        } while (ok && !z.avail_out);
+
+        // spread input reads over time to honor the rate limit; stop is
+        // checked on every chunk either way
+        total += r;
+        if (ok && !(s.rate
+                    ? pace(start + boost::posix_time::microseconds
+                           (total * 1000000 / s.rate))
+                    : running()))
+        {
+            ok = false;
+            stopped = true;
+        }
+    }
+    ::deflateEnd(&z);
+
+    // data appended to the generation after we reached its end (late
+    // writer) would be lost: start over next time
+    struct ::stat after;
+    const bool complete(ok && (::fstat(src, &after) == 0)
+                        && (std::uint64_t(after.st_size) == total));
+    ::close(src);
+
+    if (ok && (-1 == ::fsync(dst))) {
+        error = errno;
+        ok = false;
+    }
+    if ((-1 == ::close(dst)) && ok) {
+        error = errno;
+        ok = false;
+    }
+
+    if (!ok || !complete) {
+        if (!ok && !stopped) {
+            std::cerr << "Error compressing log file <" << s.filename
+                      << ">: " << error << std::endl;
+        }
+        ::unlink(tmp.c_str());
+        return ok;
+    }
+
+    // put result in place of the generation, wherever it is now
+    boost::mutex::scoped_lock guard(generationLock_);
+    for (auto i(s.keep); i >= 1; --i) {
+        const auto path(generation(s.filename, i));
+        struct ::stat gst;
+        if ((::stat(path.c_str(), &gst) == 0) && (gst.st_dev == st.st_dev)
+            && (gst.st_ino == st.st_ino))
+        {
+            if (-1 == ::rename(tmp.c_str(), (path + ".gz").c_str())) {
+                const auto error(errno);
+                std::cerr << "Error renaming compressed log file <" << path
+                          << ".gz>: " << error << std::endl;
+                ::unlink(tmp.c_str());
+                return false;
+            }
+            ::unlink(path.c_str());
+            return true;
+        }
+    }
+
+    // generation has been removed meanwhile
+    ::unlink(tmp.c_str());
+    return true;
+}
+
+void compressor::prune(const settings &s)
+{
+    if (s.filename.empty() || !s.budget) { return; }
+
+    boost::mutex::scoped_lock guard(generationLock_);
+    std::vector<std::uint64_t> sizes(s.keep + 1);
+    std::uint64_t total(0);
+    for (unsigned int i(1); i <= s.keep; ++i) {
+        const auto path(generation(s.filename, i));
+        sizes[i] = (fileSize(path) + fileSize(path + ".gz")
+                    + fileSize(path + blocks::indexSuffix));
+        total += sizes[i];
+    }
+
+    for (auto i(s.keep); (i >= 1) && (total > s.budget); --i) {
+        if (!sizes[i]) { continue; }
+        const auto path(generation(s.filename, i));
+        ::unlink(path.c_str());
+        ::unlink((path + ".gz").c_str());
+        ::unlink((path + blocks::indexSuffix).c_str());
+        total -= sizes[i];
+    }
+}
+
+#endif // DBGLOG_HAS_ZLIB
+
+} } // namespace dbglog::detail
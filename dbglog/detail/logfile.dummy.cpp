@@ -25,10 +25,26 @@
  */
 
 #include "../logfile.hpp"
+#ifndef _WIN32
+#include "uring.hpp"
+#include "mmap.hpp"
+#include "compress.hpp"
+#include "blocks.hpp"
+#endif
 
 namespace dbglog {
 
 logger_file::logger_file()
+    : use_file_(false), mode_(detail::DefaultMode), fd_(-1)
+#ifndef _WIN32
+    , bufferSize_(0), flushInterval_(DefaultFlushInterval)
+    , flusherRunning_(false), useUring_(false), useMmap_(false)
+    , mmapChunkSize_(0), written_(0), rotateSize_(0), rotateInterval_(0)
+    , rotateKeep_(DefaultRotateKeep), rotatePending_(false)
+    , rotatorRunning_(false), blocks_(false), blockTime_()
+    , blockLevels_(0), sealedTime_(), sealedLevels_(0), compressing_(false)
+    , blockOffset_(0), indexFd_(-1)
+#endif
 {}
 
 logger_file::~logger_file()
@@ -60,7 +76,42 @@ bool logger_file::closeOnExec(bool value) {
     return false;
 }
 
-bool logger_file::write_file(const char *data, std::size_t left) {
+bool logger_file::log_file_buffer(std::size_t bufferSize
+                                  , unsigned int flushInterval) {
+    return false;
+}
+
+void logger_file::flush_file() {}
+
+bool logger_file::log_file_uring(bool value) {
+    return false;
+}
+
+bool logger_file::log_file_mmap(std::size_t chunkSize) {
+    return false;
+}
+
+bool logger_file::log_file_rotate(std::uint64_t maxSize, unsigned int interval
+                                  , unsigned int keep) {
+    return false;
+}
+
+bool logger_file::log_file_rotate_now() {
+    return false;
+}
+
+bool logger_file::log_file_compress(bool value, std::uint64_t rate
+                                    , std::uint64_t budget) {
+    return false;
+}
+
+bool logger_file::log_file_blocks(std::size_t blockSize
+                                  , unsigned int flushInterval) {
+    return false;
+}
+
+bool logger_file::write_file(const char *data, std::size_t left
+                             , bool urgent, level l, const timestamp *time) {
     return false;
 }
 
@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mmap.hpp"
+#include "../logfile.hpp"
+
+namespace dbglog { namespace detail {
+
+namespace {
+
+/** Size of (virtual) file mapping; file is preallocated only as needed.
+ */
+const std::size_t MaxWindow(sizeof(void*) > 4
+                            ? std::size_t(1) << 40 : std::size_t(1) << 28);
+
+int allocate(int fd, std::uint64_t offset, std::uint64_t size)
+{
+#ifdef __linux__
+    const int res(TEMP_FAILURE_RETRY(::fallocate(fd, 0, offset, size)));
+    if (!res || ((errno != EOPNOTSUPP) && (errno != ENOSYS))) {
+        return res;
+    }
+    // filesystem cannot preallocate, just extend the file
+    return ::ftruncate(fd, offset + size);
+#else
+    const int res(::posix_fallocate(fd, offset, size));
+    if (res) { errno = res; return -1; }
+    return 0;
+#endif
+}
+
+} // namespace
+
+mmap_writer::mmap_writer()
+    : fd_(-1), chunkSize_(0), base_(nullptr), window_(0), mapOffset_(0)
+    , reserved_(0), allocated_(0), limit_(0), users_(0), closed_(true)
+{}
+
+mmap_writer::~mmap_writer()
+{
+    close();
+}
+
+bool mmap_writer::open(int fd, std::size_t chunkSize)
+{
+    close();
+
+    struct ::stat st;
+    if (-1 == ::fstat(fd, &st)) {
+        std::cerr << "Error getting log file size: " << errno << std::endl;
+        return false;
+    }
+
+    const std::uint64_t page(::sysconf(_SC_PAGESIZE));
+    const std::uint64_t size(st.st_size);
+    mapOffset_ = size - (size % page);
+    chunkSize_ = ((std::max(chunkSize, std::size_t(1)) + page - 1) / page)
+        * page;
+
+    // try smaller window if address space is scarce
+    for (window_ = MaxWindow; window_ >= 2 * chunkSize_; window_ /= 2) {
+        void *base(::mmap(nullptr, window_, PROT_READ | PROT_WRITE
+                          , MAP_SHARED | MAP_NORESERVE, fd, mapOffset_));
+        if (base != MAP_FAILED) {
+            base_ = static_cast<char*>(base);
+            break;
+        }
+    }
+
+    if (!base_) {
+        std::cerr << "Error mapping log file: " << errno << std::endl;
+        return false;
+    }
+
+    fd_ = fd;
+    reserved_ = size - mapOffset_;
+    allocated_ = size - mapOffset_;
+    limit_ = window_;
+    closed_ = false;
+    return true;
+}
+
+bool mmap_writer::write(const char *data, std::size_t size)
+{
+    users_.fetch_add(1);
+    if (closed_.load()) {
+        users_.fetch_sub(1);
+        return false;
+    }
+
+    const auto offset(reserved_.fetch_add(size, std::memory_order_relaxed));
+    const auto end(offset + size);
+    if ((end > allocated_.load(std::memory_order_acquire))
+        && !grow(offset, end))
+    {
+        users_.fetch_sub(1);
+        return false;
+    }
+
+    std::memcpy(base_ + offset, data, size);
+    users_.fetch_sub(1);
+    return true;
+}
+
+bool mmap_writer::grow(std::uint64_t offset, std::uint64_t end)
+{
+    boost::mutex::scoped_lock guard(growLock_);
+    const auto allocated(allocated_.load(std::memory_order_relaxed));
+    if (end <= allocated) { return true; }
+
+    // never grow after failure: nothing past it would survive truncation
+    if (limit_.load() < window_) {
+        fail(offset);
+        return false;
+    }
+
+    // whole chunks, capped by mapping size
+    const auto newEnd(std::min(std::uint64_t(window_)
+                               , ((end + chunkSize_ - 1) / chunkSize_)
+                               * chunkSize_));
+    if (newEnd < end) {
+        fail(offset);
+        return false;
+    }
+
+    if (-1 == allocate(fd_, mapOffset_ + allocated, newEnd - allocated)) {
+        std::cerr << "Error preallocating log file: " << errno << std::endl;
+        fail(offset);
+        return false;
+    }
+
+    allocated_.store(newEnd, std::memory_order_release);
+    return true;
+}
+
+void mmap_writer::fail(std::uint64_t offset)
+{
+    auto limit(limit_.load());
+    while ((offset < limit) && !limit_.compare_exchange_weak(limit, offset))
+    {}
+}
+
+void mmap_writer::close()
+{
+    if (closed_.exchange(true) || !base_) { return; }
+
+    // wait for running writes
+    while (users_.load()) { boost::this_thread::yield(); }
+
+    ::munmap(base_, window_);
+    base_ = nullptr;
+
+    // drop preallocated tail
+    const auto used(std::min(reserved_.load(), limit_.load()));
+    if (-1 == ::ftruncate(fd_, mapOffset_ + used)) {
+        std::cerr << "Error truncating log file: " << errno << std::endl;
+    }
+    fd_ = -1;
+}
+
+} } // namespace dbglog::detail
@@ -24,12 +24,29 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sys/uio.h>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
 #include "../logfile.hpp"
+#include "uring.hpp"
+#include "mmap.hpp"
+#include "compress.hpp"
+#include "blocks.hpp"
 
 namespace dbglog {
 
 logger_file::logger_file()
-    : use_file_(false), fd_(::open("/dev/null", O_WRONLY))
+    : use_file_(false), mode_(detail::DefaultMode)
+    , fd_(::open("/dev/null", O_WRONLY))
+    , bufferSize_(0), flushInterval_(DefaultFlushInterval)
+    , flusherRunning_(false), useUring_(false), useMmap_(false)
+    , mmapChunkSize_(0), written_(0), rotateSize_(0), rotateInterval_(0)
+    , rotateKeep_(DefaultRotateKeep), rotatePending_(false)
+    , rotatorRunning_(false), blocks_(false), blockTime_()
+    , blockLevels_(0), sealedTime_(), sealedLevels_(0), compressing_(false)
+    , blockOffset_(0), indexFd_(-1)
 {
     if (-1 == fd_) {
         throw std::runtime_error
@@ -38,11 +55,19 @@ logger_file::logger_file()
 }
 
 logger_file::~logger_file() {
+    stop_rotator();
+    compressor_.reset();
+    stop_flusher();
+    flush_file();
+    if (uring_) { uring_->stop(); }
+    if (mmap_) { mmap_->close(); }
+
     if (-1 == fd_) {
         return;
     }
 
     ::close(fd_);
+    if (-1 != indexFd_) { ::close(indexFd_); }
 
     for (auto fd : ties_) {
         ::close(fd);
@@ -53,14 +78,31 @@ bool logger_file::log_file(const std::string &filename
               , ::mode_t mode)
 {
     boost::mutex::scoped_lock guard(m_);
+    // buffered lines belong to the old file
+    flush_file();
+    // truncate mapped file to used length; writers go on with regular
+    // writes meanwhile
+    useMmap_ = false;
+    if (mmap_) { mmap_->close(); }
+
+    // blocks go either to old file and index or to new ones
+    boost::unique_lock<boost::mutex> blockGuard(bufferLock_, boost::defer_lock);
+    if (blocks_) {
+        blockGuard.lock();
+        // blocks sealed so far belong to the current file
+        wait_blocks(true);
+    }
+
     if (filename.empty()) {
         if (!open_file("/dev/null", fd_, mode)) {
+            mmap_open();
             return false;
         }
         use_file_ = false;
         retie(); // back to /dev/null to allow log file to be closed
     } else {
         if (!open_file(filename, fd_, mode)) {
+            mmap_open();
             return false;
         }
         use_file_ = true;
@@ -68,6 +110,18 @@ bool logger_file::log_file(const std::string &filename
     }
 
     filename_ = filename;
+    mode_ = mode;
+
+    struct ::stat st;
+    written_ = ((use_file_ && (::fstat(fd_, &st) == 0)) ? st.st_size : 0);
+
+    if (compressor_ && use_file_) {
+        compressor_->notify(filename_, mode_, rotateKeep_);
+    }
+
+    if (blocks_ && !open_index()) { return false; }
+
+    mmap_open();
     return true;
 }
 
@@ -77,12 +131,35 @@ bool logger_file::log_file_truncate() {
         return false;
     }
 
+    useMmap_ = false;
+    if (mmap_) { mmap_->close(); }
+
+    // pending block goes to the truncated file, i.e. index must follow
+    boost::unique_lock<boost::mutex> blockGuard(bufferLock_, boost::defer_lock);
+    if (blocks_) {
+        blockGuard.lock();
+        // blocks sealed so far belong to the current file
+        wait_blocks(true);
+    }
+
     if (::ftruncate(fd_, 0) == -1) {
         std::cerr << "Error truncating log file <" << filename_
                   << ">: " << errno << std::endl;
+        mmap_open();
         return false;
     }
 
+    written_ = 0;
+
+    if (blocks_) {
+        if ((::ftruncate(indexFd_, 0) == -1) || !open_index()) {
+            std::cerr << "Error truncating log file index <" << filename_
+                      << ">: " << errno << std::endl;
+            return false;
+        }
+    }
+
+    mmap_open();
     return true;
 }
 
@@ -157,11 +234,71 @@ bool logger_file::closeOnExec(bool value)
     return true;
 }
 
-bool logger_file::write_file(const char *data, size_t left) {
+bool logger_file::write_file(const char *data, size_t left, bool urgent
+                             , level l, const timestamp *time)
+{
     if (!use_file_) {
         return false;
     }
 
+    // block output counts compressed data
+    if (!blocks_.load(std::memory_order_relaxed)) { count_written(left); }
+
+    if (useMmap_.load(std::memory_order_acquire)
+        && (mmap_->write(data, left) || mmap_retry(data, left)))
+    {
+        return true;
+    }
+
+    if (bufferSize_.load(std::memory_order_relaxed)) {
+        boost::mutex::scoped_lock guard(bufferLock_);
+        // re-check under lock, buffering could have been switched off
+        const auto bufferSize(bufferSize_.load(std::memory_order_relaxed));
+        if (bufferSize) {
+            if (blocks_.load(std::memory_order_relaxed)) {
+                if (buffer_.empty()) {
+                    blockTime_ = (time ? *time : detail::current_time());
+                }
+                blockLevels_ |= l;
+            }
+
+            if (!urgent && ((buffer_.size() + left) < bufferSize)) {
+                if (buffer_.empty()) {
+                    bufferStart_ = boost::posix_time::microsec_clock
+                        ::universal_time();
+                }
+                buffer_.append(data, left);
+                return true;
+            }
+
+            if (!urgent && blocks_.load(std::memory_order_relaxed)) {
+                // full block is compressed and written by the flusher
+                buffer_.append(data, left);
+                seal_block();
+                return true;
+            }
+
+            // buffer full or urgent line: write everything in one go
+            flush_buffer(data, left);
+            if (urgent && useUring_.load(std::memory_order_acquire)) {
+                uring_->flush();
+            }
+            return true;
+        }
+    }
+
+    write_data(data, left, urgent);
+    return true;
+}
+
+void logger_file::write_data(const char *data, size_t left, bool urgent) {
+    if (useUring_.load(std::memory_order_acquire)
+        && uring_->write(data, left))
+    {
+        if (urgent) { uring_->flush(); }
+        return;
+    }
+
     while (left) {
         ssize_t written(TEMP_FAILURE_RETRY(::write(fd_, data, left)));
         if (-1 == written) {
@@ -172,9 +309,594 @@ bool logger_file::write_file(const char *data, size_t left) {
         left -= written;
         data += written;
     }
+}
+
+bool logger_file::log_file_uring(bool value)
+{
+    boost::mutex::scoped_lock guard(m_);
+    if (!value) {
+        useUring_ = false;
+        if (uring_) { uring_->flush(); }
+        return true;
+    }
+
+    if (!uring_) {
+        uring_ = detail::uring_writer::create(fd_);
+        if (!uring_) { return false; }
+    }
+
+    useUring_.store(true, std::memory_order_release);
+    return true;
+}
+
+bool logger_file::log_file_buffer(std::size_t bufferSize
+                                  , unsigned int flushInterval)
+{
+    stop_flusher();
+
+    boost::mutex::scoped_lock guard(bufferLock_);
+    flush_buffer();
+
+    blocks_ = false;
+    bufferSize_ = bufferSize;
+    flushInterval_ = flushInterval;
+    if (!bufferSize) {
+        std::string().swap(buffer_);
+        return true;
+    }
+
+    buffer_.reserve(bufferSize);
+    flusherRunning_ = true;
+    flusher_ = boost::thread(&logger_file::flusher, this);
+    return true;
+}
+
+bool logger_file::log_file_blocks(std::size_t blockSize
+                                  , unsigned int flushInterval)
+{
+    stop_flusher();
+
+    boost::mutex::scoped_lock guard(m_);
+    if (blockSize && !blockCompressor_) {
+        blockCompressor_ = detail::block_compressor::create();
+        if (!blockCompressor_) { return false; }
+    }
+
+    // blocks are written by regular writes
+    if (blockSize && mmapChunkSize_) {
+        flush_file();
+        mmapChunkSize_ = 0;
+        mmap_open();
+        if (mmap_) { mmap_->close(); }
+    }
+
+    boost::mutex::scoped_lock blockGuard(bufferLock_);
+    // pending lines go out in previous format
+    flush_buffer();
+
+    blocks_ = false;
+    bufferSize_ = blockSize;
+    flushInterval_ = flushInterval;
+    if (!blockSize) {
+        std::string().swap(buffer_);
+        std::string().swap(raw_);
+        std::string().swap(block_);
+        return true;
+    }
+
+    if (!open_index()) {
+        bufferSize_ = 0;
+        return false;
+    }
+
+    blocks_ = true;
+    buffer_.reserve(blockSize);
+    flusherRunning_ = true;
+    flusher_ = boost::thread(&logger_file::flusher, this);
+    return true;
+}
+
+bool logger_file::log_file_mmap(std::size_t chunkSize)
+{
+    boost::mutex::scoped_lock guard(m_);
+    // mapped area cannot hold compressed blocks
+    if (chunkSize && blocks_) { return false; }
+
+    // everything queued so far must land before mapped area
+    flush_file();
+
+    useMmap_ = false;
+    if (mmap_) { mmap_->close(); }
+    if (!mmap_) { mmap_.reset(new detail::mmap_writer()); }
+
+    // file has to be reopened for reading as well (see open_file)
+    const bool reopen(chunkSize && !mmapChunkSize_ && use_file_);
+    mmapChunkSize_ = chunkSize;
+    if (reopen && !open_file(filename_, fd_, mode_)) {
+        useMmap_ = false;
+        return false;
+    }
+    mmap_open();
+    return !chunkSize || !use_file_ || useMmap_;
+}
+
+void logger_file::mmap_open()
+{
+    if (!mmapChunkSize_ || !use_file_) {
+        useMmap_ = false;
+        return;
+    }
+
+    useMmap_.store(mmap_->open(fd_, mmapChunkSize_)
+                   , std::memory_order_release);
+}
+
+bool logger_file::mmap_retry(const char *data, size_t left)
+{
+    // mapping has been closed under us (rotation, reopen): regular write,
+    // without waiting for whoever holds m_
+    if (!useMmap_.load(std::memory_order_acquire)) { return false; }
+
+    boost::mutex::scoped_lock guard(m_);
+    if (useMmap_ && mmap_->write(data, left)) { return true; }
+
+    if (useMmap_) {
+        std::cerr << "Cannot grow mapped log file <" << filename_
+                  << ">, switching to regular writes." << std::endl;
+        useMmap_ = false;
+        mmap_->close();
+    }
+    return false;
+}
+
+void logger_file::flush_file()
+{
+    {
+        boost::mutex::scoped_lock guard(bufferLock_);
+        flush_buffer();
+    }
+    if (useUring_.load(std::memory_order_acquire)) { uring_->flush(); }
+}
+
+void logger_file::flush_buffer(const char *data, size_t size)
+{
+    if (blocks_.load(std::memory_order_relaxed)) {
+        // data belong to the block as well; caller wants it written
+        if (size) { buffer_.append(data, size); }
+        seal_block();
+        wait_blocks(true);
+        return;
+    }
+
+    if (useUring_.load(std::memory_order_acquire)) {
+        // uring writer collects data itself, just hand it over
+        if (!buffer_.empty()) {
+            write_data(buffer_.data(), buffer_.size(), false);
+        }
+        if (size) { write_data(data, size, false); }
+        buffer_.clear();
+        return;
+    }
+
+    ::iovec iov[2] = {
+        { const_cast<char*>(buffer_.data()), buffer_.size() }
+        , { const_cast<char*>(data), size }
+    };
+
+    ::iovec *first(iov);
+    int count(2);
+    while (count && !first->iov_len) { ++first; --count; }
+
+    while (count) {
+        auto written(TEMP_FAILURE_RETRY(::writev(fd_, first, count)));
+        if (-1 == written) {
+            std::cerr << "Error writing to log file: "
+                      << errno << std::endl;
+            break;
+        }
+
+        // skip what has been written (partial writes are rare)
+        while (count && (std::size_t(written) >= first->iov_len)) {
+            written -= first->iov_len;
+            ++first;
+            --count;
+        }
+        if (count) {
+            first->iov_base = static_cast<char*>(first->iov_base) + written;
+            first->iov_len -= written;
+        }
+    }
+
+    buffer_.clear();
+}
+
+void logger_file::seal_block()
+{
+    if (buffer_.empty()) { return; }
+
+    wait_blocks(false);
+    sealed_.swap(buffer_);
+    sealedTime_ = blockTime_;
+    sealedLevels_ = blockLevels_;
+    buffer_.clear();
+    blockLevels_ = 0;
+    flusherWakeup_.notify_all();
+}
+
+void logger_file::wait_blocks(bool all)
+{
+    while (!sealed_.empty() || (all && compressing_)) {
+        if (!sealed_.empty() && !compressing_ && !flusherRunning_) {
+            // nobody else to do it
+            write_block(nullptr);
+            continue;
+        }
+        blockDone_.wait(bufferLock_);
+    }
+
+    // block offsets are taken from file size
+    if (all && useUring_.load(std::memory_order_acquire)) {
+        uring_->flush();
+    }
+}
+
+void logger_file::write_block(boost::mutex::scoped_lock *guard)
+{
+    detail::blocks::entry e;
+    e.rawSize = sealed_.size();
+    e.time = sealedTime_;
+    e.levels = sealedLevels_;
+
+    raw_.swap(sealed_);
+    sealed_.clear();
+    compressing_ = true;
+    // room for next sealed block
+    blockDone_.notify_all();
+
+    // blockOffset_, raw_, block_ and index are ours until compressing_ is
+    // cleared: everybody switching files waits for it (wait_blocks)
+    if (guard) { guard->unlock(); }
+
+    e.offset = blockOffset_;
+    if (blockCompressor_->compress(raw_.data(), raw_.size(), block_)) {
+        e.size = block_.size();
+
+        write_data(block_.data(), block_.size(), false);
+        blockOffset_ += block_.size();
+        count_written(block_.size());
+
+        char entry[detail::blocks::entry::encodedSize];
+        e.encode(entry);
+        if (TEMP_FAILURE_RETRY(::write(indexFd_, entry, sizeof(entry)))
+            != ssize_t(sizeof(entry)))
+        {
+            std::cerr << "Error writing log file index: "
+                      << errno << std::endl;
+        }
+    } else {
+        std::cerr << "Error compressing log block." << std::endl;
+    }
+
+    if (guard) { guard->lock(); }
+    compressing_ = false;
+    blockDone_.notify_all();
+}
+
+bool logger_file::open_index()
+{
+    const std::string path(use_file_
+                           ? filename_ + detail::blocks::indexSuffix
+                           : std::string("/dev/null"));
+    const int f(::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND
+                       , mode_));
+    if (-1 == f) {
+        std::cerr << "Error opening log file index <" << path
+                  << ">: " << errno << std::endl;
+        return false;
+    }
+
+    struct ::stat st;
+    if (use_file_ && (::fstat(f, &st) == 0) && !st.st_size) {
+        char header[detail::blocks::headerSize];
+        std::memcpy(header, detail::blocks::magic
+                    , sizeof(detail::blocks::magic));
+        std::memcpy(header + sizeof(detail::blocks::magic)
+                    , &detail::blocks::version
+                    , sizeof(detail::blocks::version));
+        if (TEMP_FAILURE_RETRY(::write(f, header, sizeof(header)))
+            != ssize_t(sizeof(header)))
+        {
+            std::cerr << "Error writing log file index <" << path
+                      << ">: " << errno << std::endl;
+        }
+    }
+
+    if (-1 == indexFd_) {
+        indexFd_ = f;
+    } else {
+        const int res(safeDup2(f, indexFd_));
+        ::close(f);
+        if (-1 == res) {
+            std::cerr << "Error dupplicating fd(" << f << ") to fd("
+                      << indexFd_ << "): " << errno << std::endl;
+            return false;
+        }
+    }
+
+    // next block goes to the end of log file; data still in flight would
+    // not be counted
+    if (useUring_.load(std::memory_order_acquire)) { uring_->flush(); }
+    blockOffset_ = ((use_file_ && (::fstat(fd_, &st) == 0))
+                    ? st.st_size : 0);
+    return true;
+}
+
+void logger_file::flusher()
+{
+    boost::mutex::scoped_lock guard(bufferLock_);
+    const boost::posix_time::time_duration interval
+        = boost::posix_time::milliseconds(flushInterval_);
+
+    while (flusherRunning_) {
+        if (!sealed_.empty()) {
+            write_block(&guard);
+            continue;
+        }
+
+        if (buffer_.empty()) {
+            flusherWakeup_.timed_wait(guard, interval);
+            continue;
+        }
+
+        const auto deadline(bufferStart_ + interval);
+        if (boost::posix_time::microsec_clock::universal_time() >= deadline) {
+            if (blocks_.load(std::memory_order_relaxed)) {
+                seal_block();
+            } else {
+                flush_buffer();
+            }
+            continue;
+        }
+
+        flusherWakeup_.timed_wait(guard, deadline);
+    }
+}
+
+void logger_file::stop_flusher()
+{
+    {
+        boost::mutex::scoped_lock guard(bufferLock_);
+        flusherRunning_ = false;
+        flusherWakeup_.notify_all();
+    }
+
+    if (flusher_.joinable()) { flusher_.join(); }
+}
+
+bool logger_file::log_file_rotate(std::uint64_t maxSize
+                                  , unsigned int interval
+                                  , unsigned int keep)
+{
+    stop_rotator();
+
+    boost::mutex::scoped_lock guard(rotateLock_);
+    rotateInterval_ = interval;
+    rotateKeep_ = keep;
+    rotatePending_ = false;
+
+    // size is not tracked while there is no limit
+    struct ::stat st;
+    written_ = ((use_file_ && (::fstat(fd_, &st) == 0)) ? st.st_size : 0);
+    rotateSize_ = maxSize;
+    if (!maxSize && !interval) { return true; }
+
+    rotatorRunning_ = true;
+    rotator_ = boost::thread(&logger_file::rotator, this);
+    return true;
+}
+
+bool logger_file::log_file_rotate_now()
+{
+    boost::mutex::scoped_lock guard(m_);
+    return rotate();
+}
+
+void logger_file::count_written(std::size_t size)
+{
+    const auto limit(rotateSize_.load(std::memory_order_relaxed));
+    if (!limit) { return; }
+
+    const auto total(written_.fetch_add(size, std::memory_order_relaxed)
+                     + size);
+    if ((total >= limit) && !rotatePending_.exchange(true)) {
+        // only the first writer over the limit gets here
+        boost::mutex::scoped_lock guard(rotateLock_);
+        rotateWakeup_.notify_all();
+    }
+}
+
+bool logger_file::rotate()
+{
+    if (!use_file_) { return false; }
+
+    // buffered lines belong to the old file
+    flush_file();
+    // writers go on with regular writes while the mapping is closed
+    useMmap_ = false;
+    if (mmap_) { mmap_->close(); }
+
+    const auto keep(rotateKeep_.load());
+    auto generation([&](unsigned int index) -> std::string {
+            return filename_ + "." + std::to_string(index);
+        });
+
+    // compressed generations (.gz) and block indices shift along
+    const std::string index(detail::blocks::indexSuffix);
+    const char *suffixes[] = { "", ".gz", detail::blocks::indexSuffix };
+
+    // writers keep writing into renamed file until new one replaces it
+    if (keep) {
+        boost::mutex::scoped_lock generationGuard(generationLock_);
+
+        // live file goes aside first: nothing is shifted if it cannot move
+        const std::string aside(filename_ + ".rotating");
+        if (-1 == ::rename(filename_.c_str(), aside.c_str())) {
+            std::cerr << "Error renaming log file <" << filename_
+                      << ">: " << errno << std::endl;
+            mmap_open();
+            return false;
+        }
+
+        // renames done so far, undone on failure; the oldest generation is
+        // only moved aside until everything is in place
+        std::vector<std::pair<std::string, std::string> > moved;
+        std::vector<std::string> dropped;
+        auto shift([&](const std::string &from, const std::string &to)
+                  -> bool
+        {
+            if (-1 == ::rename(from.c_str(), to.c_str())) {
+                // missing generation is fine
+                if (errno == ENOENT) { return true; }
+                const auto error(errno);
+                std::cerr << "Error renaming log file <" << from
+                          << "> to <" << to << ">: " << error << std::endl;
+                return false;
+            }
+            moved.emplace_back(from, to);
+            return true;
+        });
+
+        bool ok(true);
+        for (const auto suffix : suffixes) {
+            dropped.push_back(generation(keep) + suffix + ".drop");
+            ok = shift(generation(keep) + suffix, dropped.back());
+            for (auto i(keep); ok && (i > 1); --i) {
+                ok = shift(generation(i - 1) + suffix
+                          , generation(i) + suffix);
+            }
+            if (!ok) { break; }
+        }
+        if (ok) { ok = shift(aside, generation(1)); }
+
+        if (!ok) {
+            // roll back: every generation and live file where they were
+            for (auto i(moved.rbegin()); i != moved.rend(); ++i) {
+                ::rename(i->second.c_str(), i->first.c_str());
+            }
+            ::rename(aside.c_str(), filename_.c_str());
+            mmap_open();
+            return false;
+        }
+
+        for (const auto &drop : dropped) { ::unlink(drop.c_str()); }
+
+        // blocks written meanwhile land in renamed file and index
+        ::rename((filename_ + index).c_str()
+                 , (generation(1) + index).c_str());
+    } else {
+        ::unlink(filename_.c_str());
+        ::unlink((filename_ + index).c_str());
+    }
+
+    // blocks go either to old file and index or to new ones
+    boost::unique_lock<boost::mutex> blockGuard(bufferLock_, boost::defer_lock);
+    if (blocks_) {
+        blockGuard.lock();
+        // blocks sealed so far belong to the current file
+        wait_blocks(true);
+    }
+
+    // atomic switch: writers see either file, never closed descriptor
+    if (!open_file(filename_, fd_, mode_)) {
+        mmap_open();
+        return false;
+    }
+    retie();
+    if (blocks_) { open_index(); }
+    if (blockGuard.owns_lock()) { blockGuard.unlock(); }
+
+    written_ = 0;
+    mmap_open();
+
+    if (compressor_) { compressor_->notify(filename_, mode_, keep); }
+    return true;
+}
+
+bool logger_file::log_file_compress(bool value, std::uint64_t rate
+                                    , std::uint64_t budget)
+{
+    boost::mutex::scoped_lock guard(m_);
+    if (!value) {
+        // joins the compressor; it never waits for m_
+        compressor_.reset();
+        return true;
+    }
+
+    if (!compressor_) {
+        compressor_ = detail::compressor::create(generationLock_);
+        if (!compressor_) { return false; }
+    }
+
+    compressor_->limits(rate, budget);
+    if (use_file_) { compressor_->notify(filename_, mode_, rotateKeep_); }
     return true;
 }
 
+void logger_file::rotator()
+{
+    boost::mutex::scoped_lock guard(rotateLock_);
+
+    while (rotatorRunning_) {
+        // next rotation time, aligned to wall clock
+        const bool timed(rotateInterval_ != 0);
+        const auto deadline
+            (timed
+             ? boost::posix_time::from_time_t
+             (((std::time(nullptr) / rotateInterval_) + 1) * rotateInterval_)
+             : boost::posix_time::pos_infin);
+
+        while (rotatorRunning_ && !rotatePending_) {
+            if (timed && (boost::posix_time::microsec_clock::universal_time()
+                          >= deadline))
+            {
+                break;
+            }
+
+            if (timed) {
+                rotateWakeup_.timed_wait(guard, deadline);
+            } else {
+                rotateWakeup_.wait(guard);
+            }
+        }
+        if (!rotatorRunning_) { break; }
+
+        // rotate without holding rotateLock_: writers reaching the limit
+        // meanwhile are not held up
+        guard.unlock();
+        bool rotated;
+        {
+            boost::mutex::scoped_lock fileGuard(m_);
+            rotated = rotate();
+        }
+        // failed rotation (error has been reported) is retried once another
+        // maxSize bytes are written, not on every line over the limit
+        if (!rotated) { written_ = 0; }
+        rotatePending_ = false;
+        guard.lock();
+    }
+}
+
+void logger_file::stop_rotator()
+{
+    {
+        boost::mutex::scoped_lock guard(rotateLock_);
+        rotatorRunning_ = false;
+        rotateWakeup_.notify_all();
+    }
+
+    if (rotator_.joinable()) { rotator_.join(); }
+}
+
 bool logger_file::open_file(const std::string &filename, int dest
                , ::mode_t mode)
 {
@@ -195,7 +917,10 @@ bool logger_file::open_file(const std::string &filename, int dest
 
     private:
         int fd_;
-    } f(::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, mode));
+    } f(::open(filename.c_str()
+               // shared writable mapping needs read access as well
+               , (mmapChunkSize_ ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND
+               , mode));
 
     if (-1 == f) {
         std::cerr << "Error opening log file <" << filename
@@ -0,0 +1,394 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#include "uring.hpp"
+#include "../logfile.hpp"
+
+#ifdef DBGLOG_HAS_IO_URING
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+namespace dbglog { namespace detail {
+
+#ifndef DBGLOG_HAS_IO_URING
+
+struct uring_writer::ring {};
+
+std::unique_ptr<uring_writer> uring_writer::create(int)
+{
+    return {};
+}
+
+uring_writer::~uring_writer() {}
+bool uring_writer::write(const char*, std::size_t) { return false; }
+void uring_writer::flush() {}
+void uring_writer::stop() {}
+
+#else
+
+namespace {
+
+/** Maximum of pending data before producers have to wait.
+ */
+const std::size_t MaxPending(16 << 20);
+
+const std::uint64_t WriteRequest(1);
+
+} // namespace
+
+/** Raw io_uring instance (no liburing needed).
+ */
+struct uring_writer::ring : boost::noncopyable {
+    ring() : fd(-1), sqPtr(MAP_FAILED), sqSize(0), cqPtr(MAP_FAILED)
+           , cqSize(0), sqes(nullptr), sqesSize(0)
+    {}
+
+    ~ring() {
+        if (sqes) { ::munmap(sqes, sqesSize); }
+        if ((cqPtr != MAP_FAILED) && (cqPtr != sqPtr)) {
+            ::munmap(cqPtr, cqSize);
+        }
+        if (sqPtr != MAP_FAILED) { ::munmap(sqPtr, sqSize); }
+        if (fd >= 0) { ::close(fd); }
+    }
+
+    bool init(unsigned int entries);
+
+    /** Fills and submits one request. Single producer only.
+     */
+    bool submit(std::uint8_t opcode, int fd, const char *data
+                , std::size_t size, std::uint64_t userData);
+
+    /** Waits for at least one completion.
+     */
+    bool wait();
+
+    /** Calls fn(cqe) for each available completion.
+     */
+    template <typename Fn> void reap(Fn fn);
+
+    int fd;
+
+    void *sqPtr;
+    std::size_t sqSize;
+    void *cqPtr;
+    std::size_t cqSize;
+    io_uring_sqe *sqes;
+    std::size_t sqesSize;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    io_uring_cqe *cqes;
+};
+
+bool uring_writer::ring::init(unsigned int entries)
+{
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    fd = int(::syscall(__NR_io_uring_setup, entries, &p));
+    if (fd < 0) { return false; }
+
+    // we need IORING_OP_WRITE (Linux 5.6+), probe for it
+    const std::size_t probeSize(sizeof(io_uring_probe)
+                                + 256 * sizeof(io_uring_probe_op));
+    std::unique_ptr<char[]> probeBuffer(new char[probeSize]());
+    auto *probe(reinterpret_cast<io_uring_probe*>(probeBuffer.get()));
+    if ((::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE
+                   , probe, 256) < 0)
+        || (probe->last_op < IORING_OP_WRITE)
+        || !(probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED))
+    {
+        return false;
+    }
+
+    sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single(p.features & IORING_FEAT_SINGLE_MMAP);
+    if (single) { sqSize = cqSize = std::max(sqSize, cqSize); }
+
+    sqPtr = ::mmap(nullptr, sqSize, PROT_READ | PROT_WRITE
+                   , MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqPtr == MAP_FAILED) { return false; }
+
+    cqPtr = (single ? sqPtr
+             : ::mmap(nullptr, cqSize, PROT_READ | PROT_WRITE
+                      , MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING));
+    if (cqPtr == MAP_FAILED) { return false; }
+
+    sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    auto *sqesPtr(::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE
+                         , MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqesPtr == MAP_FAILED) { return false; }
+    sqes = static_cast<io_uring_sqe*>(sqesPtr);
+
+    auto *sq(static_cast<char*>(sqPtr));
+    sqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+
+    auto *cq(static_cast<char*>(cqPtr));
+    cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+    return true;
+}
+
+bool uring_writer::ring::submit(std::uint8_t opcode, int file
+                                , const char *data, std::size_t size
+                                , std::uint64_t userData)
+{
+    const auto tail(*sqTail);
+    const auto index(tail & *sqMask);
+    auto &sqe(sqes[index]);
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = file;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(data);
+    sqe.len = unsigned(size);
+    // -1: use (and advance) file position, i.e. append
+    sqe.off = std::uint64_t(-1);
+    // never do the I/O in submitter's context
+    sqe.flags = IOSQE_ASYNC;
+    sqe.user_data = userData;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    for (;;) {
+        const auto res(::syscall(__NR_io_uring_enter, fd, 1, 0, 0
+                                 , nullptr, 0));
+        if (res >= 0) { return true; }
+        if ((errno != EINTR) && (errno != EAGAIN)) { return false; }
+    }
+}
+
+bool uring_writer::ring::wait()
+{
+    const auto res(::syscall(__NR_io_uring_enter, fd, 0, 1
+                             , IORING_ENTER_GETEVENTS, nullptr, 0));
+    return (res >= 0) || (errno == EINTR);
+}
+
+template <typename Fn>
+void uring_writer::ring::reap(Fn fn)
+{
+    auto head(*cqHead);
+    const auto tail(__atomic_load_n(cqTail, __ATOMIC_ACQUIRE));
+    for (; head != tail; ++head) {
+        fn(cqes[head & *cqMask]);
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+std::unique_ptr<uring_writer> uring_writer::create(int fd)
+{
+    std::unique_ptr<ring> r(new ring());
+    if (!r->init(8)) { return {}; }
+    return std::unique_ptr<uring_writer>(new uring_writer(std::move(r), fd));
+}
+
+uring_writer::uring_writer(std::unique_ptr<ring> &&r, int fd)
+    : ring_(std::move(r)), fd_(fd), inflightOffset_(0)
+    , stopping_(false), stopped_(false)
+{
+    reaper_ = boost::thread(&uring_writer::run, this);
+}
+
+uring_writer::~uring_writer()
+{
+    stop();
+}
+
+bool uring_writer::write(const char *data, std::size_t size)
+{
+    if (!size) { return true; }
+
+    boost::mutex::scoped_lock guard(m_);
+    while (!stopping_ && (pending_.size() > MaxPending)) {
+        done_.wait(guard);
+    }
+    if (stopping_) { return false; }
+
+    const bool wakeup(idle());
+    pending_.append(data, size);
+    // reaper sleeps only when there is nothing to do
+    if (wakeup) { work_.notify_one(); }
+    return true;
+}
+
+bool uring_writer::submit_inflight()
+{
+    if (ring_->submit(IORING_OP_WRITE, fd_
+                      , inflight_.data() + inflightOffset_
+                      , inflight_.size() - inflightOffset_
+                      , WriteRequest))
+    {
+        return true;
+    }
+
+    std::cerr << "Error submitting write to log file: "
+              << errno << std::endl;
+    // write synchronously, keep order
+    write_sync(inflight_.data() + inflightOffset_
+               , inflight_.size() - inflightOffset_);
+    return false;
+}
+
+void uring_writer::write_sync(const char *data, std::size_t left)
+{
+    while (left) {
+        const auto written(TEMP_FAILURE_RETRY(::write(fd_, data, left)));
+        if (-1 == written) { break; }
+        data += written;
+        left -= written;
+    }
+}
+
+void uring_writer::flush()
+{
+    boost::mutex::scoped_lock guard(m_);
+    while (!idle()) { done_.wait(guard); }
+}
+
+void uring_writer::stop()
+{
+    {
+        boost::mutex::scoped_lock guard(m_);
+        if (stopped_) { return; }
+        stopping_ = true;
+        work_.notify_all();
+        done_.notify_all();
+        while (!idle()) { done_.wait(guard); }
+        stopped_ = true;
+    }
+
+    if (reaper_.joinable()) { reaper_.join(); }
+}
+
+void uring_writer::run()
+{
+    // NB: all requests are submitted from this thread: io_uring cancels
+    // requests of exiting threads and logging threads come and go
+    boost::mutex::scoped_lock guard(m_);
+    for (;;) {
+        if (inflight_.empty()) {
+            if (!pending_.empty()) {
+                // take pending data under lock, submit without it
+                inflight_.swap(pending_);
+                pending_.clear();
+                inflightOffset_ = 0;
+                guard.unlock();
+                const bool submitted(submit_inflight());
+                guard.lock();
+                if (!submitted) {
+                    inflight_.clear();
+                    done_.notify_all();
+                }
+            } else {
+                done_.notify_all();
+                if (stopping_) { return; }
+                work_.wait(guard);
+            }
+            continue;
+        }
+
+        // wait for completion (and resubmit) without blocking producers
+        guard.unlock();
+        const bool ok(ring_->wait());
+        const auto error(errno);
+
+        bool finished(false);
+        if (ok) {
+            ring_->reap([&](const io_uring_cqe &cqe)
+            {
+                if (cqe.user_data != WriteRequest) { return; }
+
+                if ((cqe.res == -EINTR) || (cqe.res == -EAGAIN)
+                    || (cqe.res == -ECANCELED))
+                {
+                    finished = !submit_inflight();
+                    return;
+                }
+
+                if (cqe.res < 0) {
+                    std::cerr << "Error writing to log file: "
+                              << -cqe.res << std::endl;
+                    finished = true;
+                    return;
+                }
+
+                inflightOffset_ += cqe.res;
+                if (inflightOffset_ < inflight_.size()) {
+                    // partial write
+                    finished = !submit_inflight();
+                    return;
+                }
+                finished = true;
+            });
+        }
+
+        guard.lock();
+
+        if (!ok) {
+            std::cerr << "Error waiting for log file writes: "
+                      << error << std::endl;
+            // ring is unusable: write what has been accepted synchronously
+            // (in order, producers wait for m_) and switch the writer off;
+            // producers write themselves from now on
+            write_sync(inflight_.data() + inflightOffset_
+                       , inflight_.size() - inflightOffset_);
+            write_sync(pending_.data(), pending_.size());
+            inflight_.clear();
+            pending_.clear();
+            stopping_ = true;
+            continue;
+        }
+
+        if (finished) { inflight_.clear(); }
+
+        // wake up producers waiting for room
+        done_.notify_all();
+    }
+}
+
+#endif
+
+} } // namespace dbglog::detail
@@ -135,7 +135,42 @@ bool closeOnExec(bool value) {
     return false;
 }
 
-bool logger_file::write_file(const char *data, std::size_t left) {
+bool logger_file::log_file_buffer(std::size_t, unsigned int) {
+    return false;
+}
+
+void logger_file::flush_file() {}
+
+bool logger_file::log_file_uring(bool) {
+    return false;
+}
+
+bool logger_file::log_file_mmap(std::size_t) {
+    return false;
+}
+
+bool logger_file::log_file_rotate(std::uint64_t, unsigned int, unsigned int)
+{
+    return false;
+}
+
+bool logger_file::log_file_rotate_now() {
+    return false;
+}
+
+bool logger_file::log_file_compress(bool, std::uint64_t, std::uint64_t)
+{
+    return false;
+}
+
+bool logger_file::log_file_blocks(std::size_t, unsigned int)
+{
+    return false;
+}
+
+bool logger_file::write_file(const char *data, std::size_t left, bool
+                             , level, const timestamp*)
+{
     if (!use_file_) {
         return false;
     }
@@ -56,6 +56,32 @@ inline bool check_level(level l, std::atomic<bool> &once_guard)
     return detail::deflog.check_level(l, once_guard);
 }
 
+/** Logs statement's line. Call sites forced on bypass logger's (module's)
+ *  mask, other loggers know nothing about forcing nor structured fields.
+ */
+template <typename SinkType>
+inline bool log(SinkType &sink, level l, const std::string &message
+                , const location &loc, bool, const field_set*)
+{
+    return sink.log(l, message, loc);
+}
+
+inline bool log(logger &sink, level l, const std::string &message
+                , const location &loc, bool force
+                , const field_set *fields)
+{
+    return (force ? sink.log_forced(l, message, loc, fields)
+            : sink.log(l, message, loc, fields));
+}
+
+inline bool log(module &sink, level l, const std::string &message
+                , const location &loc, bool force
+                , const field_set *fields)
+{
+    return (force ? sink.log_forced(l, message, loc, fields)
+            : sink.log(l, message, loc, fields));
+}
+
 } } // namespace dbglog::detail
 
 #endif // shared_dbglog_detail_logger_hpp_included_
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_mmap_hpp_included_
+#define dbglog_detail_mmap_hpp_included_
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+namespace dbglog { namespace detail {
+
+/** Log file writer copying lines into a shared mapping of the log file.
+ *
+ *  File is preallocated in chunks; writers reserve space by an atomic
+ *  fetch_add and copy their data into the mapping, i.e. no syscall and no
+ *  lock per line. Only the thread crossing the preallocated end extends
+ *  the file (under a lock). The file is truncated to the used length on
+ *  close.
+ */
+class mmap_writer : boost::noncopyable {
+public:
+    mmap_writer();
+
+    ~mmap_writer();
+
+    /** Maps given (append-only) file, data are written after its current
+     *  end. Returns false on failure.
+     */
+    bool open(int fd, std::size_t chunkSize);
+
+    /** Copies data into the file. Returns false if writer is not open or
+     *  the file cannot grow anymore; writer has to be closed then and data
+     *  written another way.
+     */
+    bool write(const char *data, std::size_t size);
+
+    /** Waits for running writes, unmaps the file and truncates it to the
+     *  used length. Idempotent.
+     */
+    void close();
+
+private:
+    /** Preallocates file up to (at least) end; on failure marks
+     *  reservation at offset (and all following ones) failed.
+     */
+    bool grow(std::uint64_t offset, std::uint64_t end);
+
+    /** Marks all reservations from given offset failed, growLock_ must be
+     *  held.
+     */
+    void fail(std::uint64_t offset);
+
+    int fd_;
+    std::size_t chunkSize_;
+
+    /** Mapping of file from mapOffset_ (page aligned).
+     */
+    char *base_;
+    std::size_t window_;
+    std::uint64_t mapOffset_;
+
+    /** Reserved (used) length, relative to mapOffset_.
+     */
+    std::atomic<std::uint64_t> reserved_;
+
+    /** Preallocated length, relative to mapOffset_.
+     */
+    std::atomic<std::uint64_t> allocated_;
+
+    /** First failed reservation; nothing after it is written.
+     */
+    std::atomic<std::uint64_t> limit_;
+
+    /** Number of writes in progress.
+     */
+    std::atomic<unsigned int> users_;
+    std::atomic<bool> closed_;
+
+    boost::mutex growLock_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_mmap_hpp_included_
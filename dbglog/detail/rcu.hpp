@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_rcu_hpp_included_
+#define dbglog_detail_rcu_hpp_included_
+
+#include <atomic>
+#include <memory>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+namespace dbglog { namespace detail {
+
+/** Pointer to immutable value replaced by publishing a new one (RCU).
+ *
+ *  Readers enter a read section (reader) and see one consistent value
+ *  until they leave it; entering and leaving is one atomic increment and
+ *  decrement, i.e. readers never wait. Publishing swaps the pointer and
+ *  destroys the old value once all readers that could see it have left
+ *  (two-phase grace period over a pair of reader counters).
+ *
+ *  Publishers must be serialized by caller and must not publish from
+ *  inside a read section (it would wait for itself).
+ */
+template <typename T>
+class rcu_ptr : boost::noncopyable {
+public:
+    explicit rcu_ptr(T *value = new T())
+        : current_(value), epoch_(0)
+    {
+        readers_[0] = readers_[1] = 0;
+    }
+
+    ~rcu_ptr() { delete current_.load(); }
+
+    /** Read section. Value stays alive as long as the reader exists.
+     */
+    class reader : boost::noncopyable {
+    public:
+        reader(const rcu_ptr &ptr)
+            : counter_(ptr.readers_[ptr.epoch_.load() & 1])
+        {
+            counter_.fetch_add(1);
+            value_ = ptr.current_.load();
+        }
+
+        ~reader() { counter_.fetch_sub(1, std::memory_order_release); }
+
+        const T& operator*() const { return *value_; }
+        const T* operator->() const { return value_; }
+
+    private:
+        std::atomic<unsigned int> &counter_;
+        const T *value_;
+    };
+
+    /** Publishes new value, returns after the old one has been destroyed.
+     */
+    void publish(std::unique_ptr<T> value) {
+        std::unique_ptr<T> old(current_.exchange(value.release()));
+
+        // wait for readers of both counters: a reader may have picked its
+        // counter before the first flip and read the pointer after it
+        for (int phase(0); phase < 2; ++phase) {
+            auto &counter(readers_[epoch_.fetch_add(1) & 1]);
+            while (counter.load()) {
+                boost::this_thread::yield();
+            }
+        }
+    }
+
+    /** Current value; valid only for publishers (serialized by caller).
+     */
+    const T& get() const { return *current_.load(); }
+
+private:
+    std::atomic<T*> current_;
+    std::atomic<unsigned int> epoch_;
+    mutable std::atomic<unsigned int> readers_[2];
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_rcu_hpp_included_
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+#include "repeat.hpp"
+
+namespace dbglog { namespace detail {
+
+namespace {
+
+std::atomic<std::uint64_t> filterIdGenerator(0);
+
+/** Calling thread's last lines, one per filter used by the thread. Lines
+ *  are handed over to their filters' reporting threads on thread exit.
+ */
+struct local_lines {
+    std::vector<std::shared_ptr<repeat_filter::last_line> > lines;
+
+    ~local_lines() {
+        for (const auto &line : lines) {
+            boost::mutex::scoped_lock guard(line->lock);
+            line->orphan = true;
+        }
+    }
+};
+
+thread_local local_lines localLines;
+
+} // namespace
+
+repeat_filter::repeat_filter(const reporter &report)
+    : id_(++filterIdGenerator), report_(report), timeout_(0)
+    , running_(false)
+{}
+
+repeat_filter::~repeat_filter()
+{
+    timeout(0);
+}
+
+repeat_filter::last_line& repeat_filter::local()
+{
+    for (const auto &line : localLines.lines) {
+        if (line->owner == id_) { return *line; }
+    }
+
+    std::shared_ptr<last_line> line(std::make_shared<last_line>(id_));
+    {
+        boost::mutex::scoped_lock guard(lock_);
+        lines_.push_back(line);
+    }
+    localLines.lines.push_back(line);
+    return *line;
+}
+
+void repeat_filter::timeout(std::int64_t timeout)
+{
+    {
+        boost::mutex::scoped_lock guard(lock_);
+        timeout_ = timeout;
+        if (running_ && timeout) {
+            wakeup_.notify_all();
+            return;
+        }
+        running_ = (timeout != 0);
+        wakeup_.notify_all();
+    }
+
+    if (timeout) {
+        reaper_ = boost::thread(&repeat_filter::reaper, this);
+        return;
+    }
+
+    if (reaper_.joinable()) { reaper_.join(); }
+
+    boost::mutex::scoped_lock guard(lock_);
+    report(true);
+}
+
+void repeat_filter::reaper()
+{
+    boost::mutex::scoped_lock guard(lock_);
+    while (running_) {
+        // check often enough to report at most a second late
+        const auto period(std::max<std::int64_t>
+                          (std::min<std::int64_t>(timeout_, 1000000000)
+                           , 1000000));
+        wakeup_.timed_wait(guard, boost::posix_time::microseconds
+                           (period / 1000));
+        if (!running_) { break; }
+        report(false);
+    }
+}
+
+void repeat_filter::report(bool all)
+{
+    const auto now(limit_now());
+    for (auto &line : lines_) {
+        bool orphan(false);
+        {
+            boost::mutex::scoped_lock guard(line->lock);
+            if (line->count
+                && (all || line->orphan
+                    || ((now - line->since) >= timeout_)))
+            {
+                report_(*line);
+                line->count = 0;
+            }
+            orphan = line->orphan;
+        }
+        // line of exited thread is not needed anymore
+        if (orphan) { line.reset(); }
+    }
+
+    lines_.erase(std::remove(lines_.begin(), lines_.end(), nullptr)
+                 , lines_.end());
+}
+
+} } // namespace dbglog::detail
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef dbglog_detail_repeat_hpp_included_
+#define dbglog_detail_repeat_hpp_included_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <functional>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "../level.hpp"
+#include "../location.hpp"
+#include "limit.hpp"
+#include "log_helpers.hpp"
+
+namespace dbglog { namespace detail {
+
+/** Syslog-like collapsing of repeated lines: first occurrence is logged,
+ *  following identical lines (same call site, level, prefix and message) are
+ *  only counted and reported as "last message repeated N times" once the
+ *  thread logs something else or the timeout since the logged occurrence
+ *  expires.
+ *
+ *  State is kept per thread (and filter); only the thread's own (thus
+ *  uncontended) lock is taken per line. A background thread reports
+ *  repetitions whose timeout expired while their thread went quiet and
+ *  those of exited threads.
+ */
+class repeat_filter : boost::noncopyable {
+public:
+    /** Thread's last logged line. Strings keep their memory, no allocation
+     *  once warm. Location refers to own file and function names.
+     */
+    struct last_line : boost::noncopyable {
+        last_line(std::uint64_t owner)
+            : owner(owner), orphan(false), valid(false), hash(0), l(none)
+            , own(false), loc(nullptr, nullptr, 0), count(0), since(0)
+        {}
+
+        const std::uint64_t owner;
+
+        /** Owner thread vs reporting thread.
+         */
+        boost::mutex lock;
+
+        /** Owner thread has exited.
+         */
+        bool orphan;
+
+        bool valid;
+        std::uint64_t hash;
+        level l;
+        bool own;
+        std::string thread;
+        std::string prefix;
+        std::string message;
+        std::string file;
+        std::string func;
+        location loc;
+
+        /** Repetitions not reported yet.
+         */
+        std::uint64_t count;
+
+        /** Time (steady clock, ns) the line has been logged.
+         */
+        std::int64_t since;
+    };
+
+    typedef std::function<void(const last_line&)> reporter;
+
+    /** Pending repetitions found by the background thread go to report.
+     */
+    repeat_filter(const reporter &report);
+
+    ~repeat_filter();
+
+    /** Starts (timeout in ns > 0) or stops background reporting. Stopping
+     *  reports all pending repetitions.
+     */
+    void timeout(std::int64_t timeout);
+
+    /** Returns true if line repeats calling thread's last line within
+     *  timeout (ns); repetition is counted. Otherwise pending repetitions
+     *  are reported by summary(lastLine) and line becomes the last one.
+     */
+    template <typename Summary>
+    bool repeated(level l, bool own, const std::string &prefix
+                  , const std::string &message, const location &loc
+                  , std::int64_t timeout, const Summary &summary)
+    {
+        auto &last(local());
+        const auto hash(hash_line(l, message, loc));
+        const auto now(limit_now());
+
+        boost::mutex::scoped_lock guard(last.lock);
+        if (last.valid && (hash == last.hash) && (l == last.l)
+            && (loc.line == last.loc.line) && ((now - last.since) < timeout)
+            && (message == last.message) && (prefix == last.prefix)
+            && same(loc.file, last.loc.file, last.file))
+        {
+            ++last.count;
+            return true;
+        }
+
+        if (last.count) { summary(last); }
+
+        last.valid = true;
+        last.hash = hash;
+        last.l = l;
+        last.own = own;
+        last.thread.assign(thread_id::get());
+        last.prefix.assign(prefix);
+        last.message.assign(message);
+        // own copy: location can be built from a temporary string
+        last.file.assign(loc.file ? loc.file : "");
+        last.func.assign(loc.func ? loc.func : "");
+        last.loc = location(loc.file ? last.file.c_str() : nullptr
+                            , loc.func ? last.func.c_str() : nullptr
+                            , loc.line);
+        last.count = 0;
+        last.since = now;
+        return false;
+    }
+
+private:
+    /** FNV-1a of message, mixed with call site and level.
+     */
+    static std::uint64_t hash_line(level l, const std::string &message
+                                   , const location &loc)
+    {
+        std::uint64_t hash(14695981039346656037ull
+                           ^ (std::uint64_t(loc.line) << 20) ^ l);
+        for (const auto c : message) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static bool same(const char *file, const char *lastFile
+                     , const std::string &lastCopy)
+    {
+        if (!file || !lastFile) { return file == lastFile; }
+        return lastCopy == file;
+    }
+
+    /** Returns calling thread's last line for this filter.
+     */
+    last_line& local();
+
+    void reaper();
+
+    /** Reports pending repetitions: all of them or only expired ones (and
+     *  those of exited threads); lock_ must be held.
+     */
+    void report(bool all);
+
+    /** Unique identifier of this filter.
+     */
+    const std::uint64_t id_;
+
+    const reporter report_;
+
+    boost::mutex lock_;
+    boost::condition_variable wakeup_;
+
+    /** Last lines of all threads using this filter, shared with threads.
+     */
+    std::vector<std::shared_ptr<last_line> > lines_;
+
+    std::int64_t timeout_;
+    bool running_;
+    boost::thread reaper_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_repeat_hpp_included_
@@ -0,0 +1,249 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "sanitize.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#  define DBGLOG_SANITIZE_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+#if DBGLOG_SANITIZE_SSE2 && defined(__GNUC__) \
+    && (defined(__x86_64__) || defined(__i386__))
+// AVX2 code is compiled for its function only and used if CPU supports it
+#  define DBGLOG_SANITIZE_AVX2 1
+#  include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+namespace dbglog { namespace detail {
+
+namespace {
+
+#ifdef DBGLOG_SANITIZE_SSE2
+
+/** Index of lowest set bit, mask is non-zero.
+ */
+inline unsigned int lowestBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+#endif // DBGLOG_SANITIZE_SSE2
+
+template <escape_mode Mode>
+inline bool unsafe(unsigned char c)
+{
+    if (Mode == escape_mode::json) {
+        return (c < 0x20) || (c == '"') || (c == '\\');
+    }
+    return ((c < 0x20) && (c != '\t')) || (c == 0x7f);
+}
+
+template <escape_mode Mode>
+std::size_t scalar(const char *data, std::size_t from, std::size_t size)
+{
+    for (auto i(from); i < size; ++i) {
+        if (unsafe<Mode>(static_cast<unsigned char>(data[i]))) { return i; }
+    }
+    return size;
+}
+
+#ifdef DBGLOG_SANITIZE_SSE2
+
+template <escape_mode Mode>
+std::size_t sse2(const char *data, std::size_t size)
+{
+    const __m128i control(_mm_set1_epi8(0x1f));
+    const __m128i tab(_mm_set1_epi8('\t'));
+    const __m128i del(_mm_set1_epi8(0x7f));
+    const __m128i quote(_mm_set1_epi8('"'));
+    const __m128i backslash(_mm_set1_epi8('\\'));
+
+    std::size_t i(0);
+    for (; i + 16 <= size; i += 16) {
+        const __m128i v(_mm_loadu_si128
+                        (reinterpret_cast<const __m128i*>(data + i)));
+        // v <= 0x1f (unsigned)
+        __m128i hit(_mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        if (Mode == escape_mode::json) {
+            hit = _mm_or_si128(hit, _mm_or_si128
+                               (_mm_cmpeq_epi8(v, quote)
+                                , _mm_cmpeq_epi8(v, backslash)));
+        } else {
+            hit = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(v, tab), hit)
+                               , _mm_cmpeq_epi8(v, del));
+        }
+
+        if (const int mask = _mm_movemask_epi8(hit)) {
+            return i + lowestBit(unsigned(mask));
+        }
+    }
+    return scalar<Mode>(data, i, size);
+}
+
+#endif // DBGLOG_SANITIZE_SSE2
+
+#ifdef DBGLOG_SANITIZE_AVX2
+
+template <escape_mode Mode>
+__attribute__((target("avx2")))
+std::size_t avx2(const char *data, std::size_t size)
+{
+    const __m256i control(_mm256_set1_epi8(0x1f));
+    const __m256i tab(_mm256_set1_epi8('\t'));
+    const __m256i del(_mm256_set1_epi8(0x7f));
+    const __m256i quote(_mm256_set1_epi8('"'));
+    const __m256i backslash(_mm256_set1_epi8('\\'));
+
+    std::size_t i(0);
+    for (; i + 32 <= size; i += 32) {
+        const __m256i v(_mm256_loadu_si256
+                        (reinterpret_cast<const __m256i*>(data + i)));
+        __m256i hit(_mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+        if (Mode == escape_mode::json) {
+            hit = _mm256_or_si256(hit, _mm256_or_si256
+                                  (_mm256_cmpeq_epi8(v, quote)
+                                   , _mm256_cmpeq_epi8(v, backslash)));
+        } else {
+            hit = _mm256_or_si256
+                (_mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), hit)
+                 , _mm256_cmpeq_epi8(v, del));
+        }
+
+        if (const unsigned mask = unsigned(_mm256_movemask_epi8(hit))) {
+            return i + lowestBit(mask);
+        }
+    }
+    // leaving AVX code: avoid SSE transition penalty
+    _mm256_zeroupper();
+    return i + sse2<Mode>(data + i, size - i);
+}
+
+#endif // DBGLOG_SANITIZE_AVX2
+
+typedef std::size_t (*finder)(const char*, std::size_t);
+
+struct finders {
+    finder text;
+    finder json;
+    const char *isa;
+};
+
+finders select()
+{
+#ifdef DBGLOG_SANITIZE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return { &avx2<escape_mode::text>, &avx2<escape_mode::json>
+                , "avx2" };
+    }
+#endif
+#ifdef DBGLOG_SANITIZE_SSE2
+    return { &sse2<escape_mode::text>, &sse2<escape_mode::json>, "sse2" };
+#else
+    return { [](const char *data, std::size_t size) {
+                return scalar<escape_mode::text>(data, 0, size); }
+            , [](const char *data, std::size_t size) {
+                return scalar<escape_mode::json>(data, 0, size); }
+            , "scalar" };
+#endif
+}
+
+const finders& selected()
+{
+    static const finders f(select());
+    return f;
+}
+
+} // namespace
+
+std::size_t find_escape(const char *data, std::size_t size
+                        , escape_mode mode)
+{
+    const auto &f(selected());
+    return ((mode == escape_mode::json) ? f.json : f.text)(data, size);
+}
+
+std::size_t find_escape_scalar(const char *data, std::size_t size
+                               , escape_mode mode)
+{
+    return ((mode == escape_mode::json)
+            ? scalar<escape_mode::json>(data, 0, size)
+            : scalar<escape_mode::text>(data, 0, size));
+}
+
+const char* find_escape_isa()
+{
+    return selected().isa;
+}
+
+void write_escaped(std::ostream &os, const char *data, std::size_t size
+                   , escape_mode mode)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    const bool json(mode == escape_mode::json);
+    for (;;) {
+        const auto clean(find_escape(data, size, mode));
+        os.write(data, clean);
+        if (clean == size) { return; }
+
+        const auto c(static_cast<unsigned char>(data[clean]));
+        data += clean + 1;
+        size -= clean + 1;
+
+        switch (c) {
+        case '\n': os.write("\\n", 2); continue;
+        case '\r': os.write("\\r", 2); continue;
+        case '\t': os.write("\\t", 2); continue;
+        case '"': os.write("\\\"", 2); continue;
+        case '\\': os.write("\\\\", 2); continue;
+        }
+
+        const char escaped[] = {
+            '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]
+        };
+        if (json) {
+            os.write(escaped, 6);
+        } else {
+            const char x[] = { '\\', 'x', escaped[4], escaped[5] };
+            os.write(x, 4);
+        }
+    }
+}
+
+} } // namespace dbglog::detail
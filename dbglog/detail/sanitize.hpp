@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_sanitize_hpp_included_
+#define dbglog_detail_sanitize_hpp_included_
+
+#include <ostream>
+#include <cstddef>
+
+namespace dbglog { namespace detail {
+
+/** What is escaped.
+ *
+ *  text: control bytes (except tab) and DEL, i.e. message cannot break or
+ *        forge log lines;
+ *  json: control bytes, quotes and backslashes (JSON string contents).
+ */
+enum class escape_mode { text, json };
+
+/** Returns offset of first byte of data that needs escaping, size if there
+ *  is none. Uses SSE2/AVX2 where available (chosen at runtime).
+ */
+std::size_t find_escape(const char *data, std::size_t size
+                        , escape_mode mode);
+
+/** Plain C++ variant of find_escape (reference and fallback).
+ */
+std::size_t find_escape_scalar(const char *data, std::size_t size
+                               , escape_mode mode);
+
+/** Writes data escaped: \n, \r and \t (json) as such, other bytes as \xHH
+ *  (text) or \u00HH (json), quotes and backslashes (json) prefixed by
+ *  backslash. Clean runs are written at once.
+ */
+void write_escaped(std::ostream &os, const char *data, std::size_t size
+                   , escape_mode mode);
+
+/** Name of instruction set used by find_escape ("avx2", "sse2", "scalar").
+ */
+const char* find_escape_isa();
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_sanitize_hpp_included_
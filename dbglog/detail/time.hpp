@@ -27,15 +27,42 @@
 #ifndef dbglog_detail_time_hpp_included_
 #define dbglog_detail_time_hpp_included_
 
-namespace dbglog { namespace detail {
+#include <cstdint>
+
+namespace dbglog {
+
+/** Wall clock time (since Unix epoch).
+ */
+struct timestamp {
+    std::int64_t sec;
+    std::uint32_t nsec;
+};
+
+namespace detail {
 
 /** Time buffer for formatting date time[.subsecs]
- *  64 bytes is more than enough, since the format take 27 chars at most:
- *      "YYYY-MM-DD HH:MM:SS.ssssss\0"
+ *  64 bytes is more than enough, since the format take 30 chars at most:
+ *      "YYYY-MM-DD HH:MM:SS.sssssssss\0"
  */
 typedef char timebuffer[64];
 
-char* format_time(timebuffer &b, unsigned short precision = 0);
+/** Returns current time read from the cheapest clock good enough for given
+ *  sub-second precision.
+ */
+timestamp current_time(unsigned short precision = 0);
+
+/** Formats time t as local time into b with precision sub-second digits
+ *  (at most 9, i.e. nanoseconds; Windows goes down to milliseconds only).
+ */
+char* format_time(timebuffer &b, const timestamp &t
+                  , unsigned short precision = 0);
+
+/** Formats current local time, see above.
+ */
+inline char* format_time(timebuffer &b, unsigned short precision = 0)
+{
+    return format_time(b, current_time(precision), precision);
+}
 
 } } // namespace dbglog::detail
 
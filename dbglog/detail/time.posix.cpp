@@ -26,65 +26,100 @@
 
 #include "time.hpp"
 
-#include <sys/time.h>
-#include <cstdio>
+#include <cstring>
 #include <ctime>
 
 namespace dbglog { namespace detail {
 
-char* format_time(timebuffer &b, unsigned short precision)
+namespace {
+
+/** Rendered "YYYY-MM-DD HH:MM:SS" of last second seen by calling thread.
+ *  Rebuilt only when second changes, i.e. localtime_r (and its timezone lock)
+ *  is hit at most once per second per thread.
+ */
+struct second_cache {
+    bool valid;
+    std::time_t sec;
+    std::size_t size;
+    timebuffer b;
+};
+
+thread_local second_cache cache = { false, 0, 0, {} };
+
+/** Number of nanoseconds in one unit of given sub-second precision.
+ */
+long precisionUnit(unsigned short precision)
+{
+    long unit(1000000000);
+    for (; precision && (unit > 1); --precision) { unit /= 10; }
+    return unit;
+}
+
+/** Picks clock for given sub-second precision: coarse clock is used when its
+ *  resolution is good enough (it is much cheaper to read).
+ */
+clockid_t pickClock(unsigned short precision)
+{
+#ifdef CLOCK_REALTIME_COARSE
+    static const long coarse([]() -> long {
+            timespec res;
+            if (-1 == ::clock_getres(CLOCK_REALTIME_COARSE, &res)) {
+                return -1;
+            }
+            return res.tv_sec ? 1000000000 : res.tv_nsec;
+        }());
+
+    if ((coarse > 0) && (coarse <= precisionUnit(precision))) {
+        return CLOCK_REALTIME_COARSE;
+    }
+#else
+    (void) precision;
+#endif
+    return CLOCK_REALTIME;
+}
+
+} // namespace
+
+timestamp current_time(unsigned short precision)
 {
-    timeval now;
-    gettimeofday(&now, 0x0);
-    tm now_bd;
-    localtime_r(&now.tv_sec, &now_bd);
-
-    auto left(sizeof(b) - 1);
-    auto written(strftime(b, left, "%Y-%m-%d %T", &now_bd));
-    // NB: written == 0 if buffer was too short; should not happen
-    auto end(b + written);
-    left -= written;
-
-    // append sub-second fraction; snprintf writes up to left characters
-    // including final NUL
-    switch (precision) {
-    case 0: break;
-
-    case 1:
-        snprintf(end, left, ".%01u"
-                 , static_cast<unsigned int>(now.tv_usec / 100000));
-        break;
-
-    case 2:
-        snprintf(end, left, ".%02u"
-                 , static_cast<unsigned int>(now.tv_usec / 10000));
-        break;
-
-    case 3:
-        snprintf(end, left, ".%03u"
-                 , static_cast<unsigned int>(now.tv_usec / 1000));
-        break;
-
-    case 4:
-        snprintf(end, left, ".%04u"
-                 , static_cast<unsigned int>(now.tv_usec / 100));
-        break;
-
-    case 5:
-        snprintf(end, left, ".%05u"
-                 , static_cast<unsigned int>(now.tv_usec / 10));
-        break;
-
-    default:
-        // 6 and more
-        snprintf(end, left, ".%06u"
-                 , static_cast<unsigned int>(now.tv_usec));
-        break;
+    if (precision > 9) { precision = 9; }
+
+    timespec now;
+    ::clock_gettime(pickClock(precision), &now);
+    return { now.tv_sec, std::uint32_t(now.tv_nsec) };
+}
+
+char* format_time(timebuffer &b, const timestamp &t
+                  , unsigned short precision)
+{
+    if (precision > 9) { precision = 9; }
+
+    const std::time_t sec(t.sec);
+    if (!cache.valid || (cache.sec != sec)) {
+        tm now_bd;
+        localtime_r(&sec, &now_bd);
+        // NB: size == 0 if buffer was too short; should not happen
+        cache.size = strftime(cache.b, sizeof(cache.b), "%Y-%m-%d %T"
+                              , &now_bd);
+        cache.sec = sec;
+        cache.valid = true;
     }
 
-    // enforce final NUL even if snprintf truncated output (should not happen)
-    end[left] = '\0';
+    std::memcpy(b, cache.b, cache.size);
+    auto end(b + cache.size);
+
+    // append sub-second fraction, most significant digit first
+    if (precision) {
+        *end++ = '.';
+        auto value(long(t.nsec) / precisionUnit(precision));
+        for (auto i(precision); i; --i) {
+            end[i - 1] = char('0' + (value % 10));
+            value /= 10;
+        }
+        end += precision;
+    }
 
+    *end = '\0';
     return b;
 }
 
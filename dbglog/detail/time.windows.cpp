@@ -34,10 +34,35 @@
 
 namespace dbglog { namespace detail {
 
-char* format_time(timebuffer &b, unsigned short precision)
+namespace {
+
+/** 100ns intervals between 1601-01-01 (FILETIME epoch) and 1970-01-01.
+ */
+const std::uint64_t epochOffset(116444736000000000ull);
+
+} // namespace
+
+timestamp current_time(unsigned short)
+{
+    FILETIME ft;
+    ::GetSystemTimeAsFileTime(&ft);
+    const auto ticks(((std::uint64_t(ft.dwHighDateTime) << 32)
+                      | ft.dwLowDateTime) - epochOffset);
+    return { std::int64_t(ticks / 10000000)
+            , std::uint32_t((ticks % 10000000) * 100) };
+}
+
+char* format_time(timebuffer &b, const timestamp &t
+                  , unsigned short precision)
 {
+    const auto ticks(std::uint64_t(t.sec) * 10000000 + t.nsec / 100
+                     + epochOffset);
+    FILETIME ft, local;
+    ft.dwLowDateTime = DWORD(ticks);
+    ft.dwHighDateTime = DWORD(ticks >> 32);
     SYSTEMTIME now;
-    ::GetLocalTime(&now);
+    ::FileTimeToLocalFileTime(&ft, &local);
+    ::FileTimeToSystemTime(&local, &now);
     auto left(sizeof(b) - 1);
     auto written(snprintf(b, left
                           , "%04d-%02d-%02d %02d:%02d:%02d"
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef dbglog_detail_uring_hpp_included_
+#define dbglog_detail_uring_hpp_included_
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+namespace dbglog { namespace detail {
+
+/** Log file writer submitting writes through io_uring (Linux).
+ *
+ *  Producers only append data to a pending buffer. A background thread
+ *  submits collected data as a single write, waits for its completion and
+ *  submits whatever has been collected meanwhile. Exactly one write is in
+ *  flight at a time, i.e. data hit the file in the order they were written.
+ */
+class uring_writer : boost::noncopyable {
+public:
+    /** Returns new writer for given file descriptor or nullptr if io_uring
+     *  is not available (not compiled in, disabled or too old kernel).
+     */
+    static std::unique_ptr<uring_writer> create(int fd);
+
+    ~uring_writer();
+
+    /** Queues data. Returns false if writer is stopped (caller should
+     *  write data itself). Blocks only if too much data is pending.
+     */
+    bool write(const char *data, std::size_t size);
+
+    /** Waits until all queued data are written.
+     */
+    void flush();
+
+    /** Writes everything and stops. Idempotent.
+     */
+    void stop();
+
+    struct ring;
+
+private:
+    uring_writer(std::unique_ptr<ring> &&ring, int fd);
+
+    /** Submits (rest of) inflight data; falls back to synchronous write on
+     *  error. Returns false if nothing is in flight anymore. Reaper thread
+     *  only, called without m_: inflight_ is changed only by the reaper
+     *  under m_.
+     */
+    bool submit_inflight();
+
+    /** Writes data by regular write (fallback when io_uring fails).
+     */
+    void write_sync(const char *data, std::size_t left);
+
+    void run();
+
+    bool idle() const { return pending_.empty() && inflight_.empty(); }
+
+    std::unique_ptr<ring> ring_;
+    const int fd_;
+
+    boost::mutex m_;
+    boost::condition_variable done_;
+    boost::condition_variable work_;
+
+    /** Data waiting for current write to finish.
+     */
+    std::string pending_;
+
+    /** Data being written; inflightOffset_ bytes are already written.
+     */
+    std::string inflight_;
+    std::size_t inflightOffset_;
+
+    bool stopping_;
+    bool stopped_;
+    boost::thread reaper_;
+};
+
+} } // namespace dbglog::detail
+
+#endif // dbglog_detail_uring_hpp_included_
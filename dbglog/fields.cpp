@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <limits>
+
+#include "fields.hpp"
+#include "detail/sanitize.hpp"
+
+namespace dbglog {
+
+field& field_set::add(const char *key)
+{
+    if (size_ == items_.size()) { items_.emplace_back(); }
+    auto &f(items_[size_++]);
+    f.key.assign(key);
+    return f;
+}
+
+void field_set::assign(const field_set &other)
+{
+    if (items_.size() < other.size_) { items_.resize(other.size_); }
+    for (std::size_t i(0); i < other.size_; ++i) {
+        auto &f(items_[i]);
+        const auto &o(other.items_[i]);
+        f.key.assign(o.key);
+        f.t = o.t;
+        switch (o.t) {
+        case field::type::boolean: f.b = o.b; break;
+        case field::type::integer: f.i = o.i; break;
+        case field::type::uinteger: f.u = o.u; break;
+        case field::type::real: f.d = o.d; break;
+        case field::type::string: f.s.assign(o.s); break;
+        }
+    }
+    size_ = other.size_;
+}
+
+const field_set& field_set::none()
+{
+    static const field_set empty;
+    return empty;
+}
+
+std::ostream& operator<<(std::ostream &os, const field &f)
+{
+    switch (f.t) {
+    case field::type::boolean: return os << (f.b ? "true" : "false");
+    case field::type::integer: return os << f.i;
+    case field::type::uinteger: return os << f.u;
+
+    case field::type::real: {
+        const auto precision(os.precision
+                             (std::numeric_limits<double>::max_digits10));
+        os << f.d;
+        os.precision(precision);
+        return os;
+    }
+
+    case field::type::string: break;
+    }
+
+    // quoted and escaped, never breaks the line
+    os << '"';
+    detail::write_escaped(os, f.s.data(), f.s.size()
+                          , detail::escape_mode::json);
+    return os << '"';
+}
+
+namespace detail {
+
+namespace {
+
+/** Set once calling thread's pool is destroyed.
+ */
+thread_local bool poolGone(false);
+
+/** Per-thread pool of field sets.
+ */
+struct field_set_pool : boost::noncopyable {
+    ~field_set_pool() { poolGone = true; }
+
+    field_set* acquire() {
+        if (free.empty()) {
+            all.emplace_back(new field_set());
+            free.reserve(all.size());
+            return all.back().get();
+        }
+        auto *f(free.back());
+        free.pop_back();
+        return f;
+    }
+
+    void release(field_set *f) { free.push_back(f); }
+
+    std::vector<std::unique_ptr<field_set> > all;
+    std::vector<field_set*> free;
+};
+
+thread_local field_set_pool pool;
+
+} // namespace
+
+field_set& scoped_fields::acquire()
+{
+    if (poolGone) {
+        owned_.reset(new field_set());
+        f_ = owned_.get();
+    } else {
+        f_ = pool.acquire();
+    }
+    f_->clear();
+    return *f_;
+}
+
+scoped_fields::~scoped_fields()
+{
+    if (f_ && !owned_) { pool.release(f_); }
+}
+
+} // namespace detail
+
+} // namespace dbglog
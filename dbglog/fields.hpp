@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef shared_dbglog_fields_hpp_included_
+#define shared_dbglog_fields_hpp_included_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <boost/noncopyable.hpp>
+
+#include "detail/line_buffer.hpp"
+
+namespace dbglog {
+
+/** Structured (key-value) field of log record; value keeps its type.
+ */
+struct field {
+    enum class type { boolean, integer, uinteger, real, string };
+
+    std::string key;
+    type t;
+    union {
+        bool b;
+        std::int64_t i;
+        std::uint64_t u;
+        double d;
+    };
+
+    /** Value of string field.
+     */
+    std::string s;
+
+    field() : t(type::integer), i(0) {}
+};
+
+/** Fields of one record. Cleared set keeps memory of its fields, i.e. no
+ *  allocation once warm.
+ */
+class field_set {
+public:
+    typedef std::vector<field>::const_iterator const_iterator;
+
+    field_set() : size_(0) {}
+
+    const_iterator begin() const { return items_.begin(); }
+    const_iterator end() const { return items_.begin() + size_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return !size_; }
+
+    void clear() { size_ = 0; }
+
+    /** Appends field with given key; its value is set by caller.
+     */
+    field& add(const char *key);
+
+    /** Copies other set (reusing memory).
+     */
+    void assign(const field_set &other);
+
+    void swap(field_set &other) {
+        items_.swap(other.items_);
+        std::swap(size_, other.size_);
+    }
+
+    /** Empty set, used by records without fields.
+     */
+    static const field_set& none();
+
+private:
+    std::vector<field> items_;
+    std::size_t size_;
+};
+
+/** Writes field value: numbers as is, strings quoted.
+ */
+std::ostream& operator<<(std::ostream &os, const field &f);
+
+namespace detail {
+
+inline void set_field(field &f, bool value) {
+    f.t = field::type::boolean;
+    f.b = value;
+}
+
+inline void set_field(field &f, const char *value) {
+    f.t = field::type::string;
+    f.s.assign(value ? value : "");
+}
+
+inline void set_field(field &f, const std::string &value) {
+    f.t = field::type::string;
+    f.s.assign(value);
+}
+
+inline void set_field(field &f, char value) {
+    f.t = field::type::string;
+    f.s.assign(1, value);
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value
+                        && std::is_signed<T>::value>::type
+set_field(field &f, T value)
+{
+    f.t = field::type::integer;
+    f.i = value;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value
+                        && std::is_unsigned<T>::value>::type
+set_field(field &f, T value)
+{
+    f.t = field::type::uinteger;
+    f.u = value;
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+set_field(field &f, T value)
+{
+    f.t = field::type::real;
+    f.d = value;
+}
+
+/** Anything else is kept as its text.
+ */
+template <typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value
+                        && !std::is_convertible<const T&, const char*>::value
+                        && !std::is_convertible<const T&
+                                                , const std::string&>::value
+                        >::type
+set_field(field &f, const T &value)
+{
+    scoped_line_stream os;
+    *os << value;
+    f.t = field::type::string;
+    f.s.assign(os->str());
+}
+
+/** Borrows one of calling thread's reusable field sets on first use and
+ *  keeps it for its lifetime.
+ */
+class scoped_fields : boost::noncopyable {
+public:
+    scoped_fields() : f_() {}
+    ~scoped_fields();
+
+    /** Borrowed set, nullptr if none has been needed.
+     */
+    const field_set* get() const { return f_; }
+
+    field_set& operator*() { return f_ ? *f_ : acquire(); }
+
+private:
+    field_set& acquire();
+
+    field_set *f_;
+
+    /** Set when thread's pool is already gone (thread exit).
+     */
+    std::unique_ptr<field_set> owned_;
+};
+
+} // namespace detail
+
+} // namespace dbglog
+
+#endif // shared_dbglog_fields_hpp_included_
@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "json_sink.hpp"
+#include "detail/line_buffer.hpp"
+#include "detail/log_helpers.hpp"
+#include "detail/sanitize.hpp"
+
+namespace dbglog {
+
+namespace {
+
+/** Writes JSON string (quoted and escaped).
+ */
+void string(std::ostream &os, const char *data, std::size_t size)
+{
+    os.put('"');
+    detail::write_escaped(os, data, size, detail::escape_mode::json);
+    os.put('"');
+}
+
+void string(std::ostream &os, const std::string &s)
+{
+    string(os, s.data(), s.size());
+}
+
+void string(std::ostream &os, const char *s)
+{
+    if (!s) { s = ""; }
+    string(os, s, std::strlen(s));
+}
+
+void value(std::ostream &os, const field &f)
+{
+    switch (f.t) {
+    case field::type::boolean:
+        os << (f.b ? "true" : "false");
+        return;
+
+    case field::type::integer: os << f.i; return;
+    case field::type::uinteger: os << f.u; return;
+
+    case field::type::real:
+        if (!std::isfinite(f.d)) {
+            // no representation in JSON
+            os << "null";
+            return;
+        }
+        os << f.d;
+        return;
+
+    case field::type::string:
+        string(os, f.s);
+        return;
+    }
+}
+
+} // namespace
+
+void json_sink::encode(std::ostream &os, const record &r)
+{
+    // nanoseconds are written by hand, stream keeps default formatting
+    char nsec[10];
+    auto ns(r.time.nsec);
+    for (int i(8); i >= 0; --i) {
+        nsec[i] = char('0' + (ns % 10));
+        ns /= 10;
+    }
+    nsec[9] = '\0';
+
+    os << "{\"time\":" << r.time.sec << '.' << nsec
+       << ",\"level\":\"" << detail::level2string(r.l)
+       << "\",\"pid\":" << r.pid
+       << ",\"thread\":";
+    string(os, r.thread);
+
+    if (!r.module.empty()) {
+        // module prefix is "[name]"
+        const auto &m(r.module);
+        const bool brackets((m.size() >= 2) && (m.front() == '[')
+                            && (m.back() == ']'));
+        os << ",\"module\":";
+        if (brackets) {
+            string(os, m.data() + 1, m.size() - 2);
+        } else {
+            string(os, m);
+        }
+    }
+
+    os << ",\"message\":";
+    string(os, r.message);
+    os << ",\"file\":";
+    string(os, r.loc.file);
+    os << ",\"func\":";
+    string(os, r.loc.func);
+    os << ",\"line\":" << r.loc.line;
+
+    if (!r.fields.empty()) {
+        const auto precision(os.precision
+                             (std::numeric_limits<double>::max_digits10));
+        os << ",\"fields\":{";
+        bool first(true);
+        for (const auto &f : r.fields) {
+            if (!first) { os.put(','); }
+            first = false;
+            string(os, f.key);
+            os.put(':');
+            value(os, f);
+        }
+        os.put('}');
+        os.precision(precision);
+    }
+
+    os.write("}\n", 2);
+}
+
+void json_sink::write_record(const record &r)
+{
+    detail::scoped_line_stream os;
+    encode(*os, r);
+    // errors must not wait in the file buffer
+    write_file(os->str(), (r.l & (err1 | fatal)) != 0, r.l, &r.time);
+}
+
+void json_sink::write(const std::string &line)
+{
+    auto size(line.size());
+    if (size && (line[size - 1] == '\n')) { --size; }
+
+    detail::scoped_line_stream os;
+    os->write("{\"message\":", 11);
+    string(*os, line.data(), size);
+    os->write("}\n", 2);
+    write_file(os->str());
+}
+
+} // namespace dbglog
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef shared_dbglog_json_sink_hpp_included_
+#define shared_dbglog_json_sink_hpp_included_
+
+#include <string>
+#include <ostream>
+
+#include "sink.hpp"
+#include "record.hpp"
+#include "logfile.hpp"
+
+namespace dbglog {
+
+/** Sink writing records as JSON lines, one object per record:
+ *
+ *  {"time":1508237411.123456789,"level":"I3","pid":1234,"thread":"1"
+ *   ,"module":"db","message":"done","file":"db.cpp","func":"query"
+ *   ,"line":42,"fields":{"req":17,"ms":3.5}}
+ *
+ *  Module and fields are present only if set. Encoder writes directly into
+ *  calling thread's reusable buffer, i.e. no allocation once warm. Output
+ *  file supports the same modes as logger's log file (buffering etc.).
+ */
+class json_sink : public Sink, public logger_file {
+public:
+    json_sink(const mask &mask = dbglog::mask(default_)
+              , const std::string &name = "json")
+        : Sink(mask, name)
+    {}
+
+    /** Opens (appends to) output file, empty filename closes it.
+     */
+    bool open(const std::string &filename) { return log_file(filename); }
+
+    virtual void write_record(const record &r);
+
+    /** Plain line is written as an object with message only.
+     */
+    virtual void write(const std::string &line);
+
+    /** Writes record as one JSON object followed by newline.
+     */
+    static void encode(std::ostream &os, const record &r);
+};
+
+} // namespace dbglog
+
+#endif // shared_dbglog_json_sink_hpp_included_
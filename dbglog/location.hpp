@@ -37,16 +37,59 @@
 
 namespace dbglog {
 
+namespace detail {
+
+constexpr long rfindSeparator(const char *path, long lo, long hi);
+
+constexpr long rfindSeparator(long found, const char *path, long lo, long hi)
+{
+    return (found >= 0) ? found : rfindSeparator(path, lo, hi);
+}
+
+/** Index of last path separator in path[lo, hi), -1 if there is none.
+ *  Halves the range on each step to keep recursion depth low.
+ */
+constexpr long rfindSeparator(const char *path, long lo, long hi)
+{
+    return (((hi - lo) <= 1)
+            ? (((hi > lo) && (path[lo] == DBGLOG_PATH_SEPARATOR)) ? lo : -1)
+            : rfindSeparator(rfindSeparator(path, lo + (hi - lo) / 2, hi)
+                             , path, lo, lo + (hi - lo) / 2));
+}
+
+/** Compile-time basename of string literal (e.g. __FILE__).
+ */
+template <std::size_t N>
+constexpr const char* basename(const char (&path)[N])
+{
+    return path + 1 + rfindSeparator(path, 0, long(N) - 1);
+}
+
+} // namespace detail
+
 struct location {
     const char *file;
     const char *func;
     size_t line;
 
+    /** Preformatted "{file:func():line}" (if available), written as is
+     *  instead of formatting location on every line.
+     */
+    const char *formatted;
+    size_t formattedSize;
+
     location(const char *file, const char *func, size_t line
              , bool trimFile = false)
         : file(trimFile ? trim(file) : file), func(func), line(line)
+        , formatted(nullptr), formattedSize(0)
     {}
 
+    /** Creates location with preformatted text. Meant for call sites'
+     *  static locations: preformatted text is never freed.
+     */
+    static location preformat(const char *file, const char *func
+                              , size_t line);
+
 private:
     static const char *trim(const char *file) {
         const char *end = strrchr(file, DBGLOG_PATH_SEPARATOR);
@@ -29,10 +29,16 @@
 #include <set>
 #include <string>
 #include <iostream>
+#include <atomic>
+#include <memory>
+#include <cstdint>
 
 #include <boost/noncopyable.hpp>
 #include <boost/thread.hpp>
 
+#include "level.hpp"
+#include "detail/time.hpp"
+
 #ifndef _WIN32
 #include <sys/types.h>
 #include <unistd.h>
@@ -63,6 +69,10 @@ namespace dbglog {
 
 namespace detail {
     const ::mode_t DefaultMode(S_IRUSR | S_IWUSR);
+    class uring_writer;
+    class mmap_writer;
+    class compressor;
+    class block_compressor;
 }
 
 class logger_file : boost::noncopyable {
@@ -85,12 +95,111 @@ public:
 
     bool closeOnExec(bool value);
 
+    /** Switches buffered output on (bufferSize > 0) or off (0). Buffered
+     *  lines are written together by a single writev once bufferSize bytes
+     *  are collected, flushInterval milliseconds after the first buffered
+     *  line, before an urgent line or on flush_file(). Lines are never split
+     *  between writes. Returns false if not supported on this platform.
+     */
+    bool log_file_buffer(std::size_t bufferSize
+                         , unsigned int flushInterval
+                         = DefaultFlushInterval);
+
+    /** Writes buffered lines.
+     */
+    void flush_file();
+
+    /** Switches io_uring writes on/off. Writes are only queued by the
+     *  logging thread and submitted/completed in the background, i.e. slow
+     *  disk doesn't stall logging threads. Urgent lines are waited for.
+     *  Returns false if io_uring is not available (not Linux, kernel too
+     *  old or io_uring disabled), synchronous writes are used then.
+     */
+    bool log_file_uring(bool value = true);
+
+    /** Switches memory mapped output on (chunkSize > 0) or off (0). Log
+     *  file is preallocated in chunks of chunkSize bytes and lines are
+     *  copied into its shared mapping without any syscall or lock; the file
+     *  is truncated to used length when closed, reopened or switched back.
+     *  Until then, readers see zeros after the last line. Data written to
+     *  tied file descriptors meanwhile are lost. Falls back to regular
+     *  writes if the file cannot grow. Returns false if not supported.
+     */
+    bool log_file_mmap(std::size_t chunkSize = DefaultMmapChunkSize);
+
+    /** Rotates log file when it grows over maxSize bytes (0: no size limit)
+     *  and every interval seconds aligned to UTC wall clock (0: no time
+     *  limit), i.e. daily rotation happens at UTC midnight, not local one.
+     *  Log file is renamed to filename.1 (older generations shift up to
+     *  filename.keep, the oldest one is removed) and fresh file is opened
+     *  in its place; tied file descriptors follow it. Rotation runs in a
+     *  background thread: writers never wait for it and no line is lost
+     *  (lines written meanwhile land in the old file). Both limits zero
+     *  switch rotation off. Returns false if not supported.
+     */
+    bool log_file_rotate(std::uint64_t maxSize, unsigned int interval = 0
+                         , unsigned int keep = DefaultRotateKeep);
+
+    /** Rotates log file right now. Returns false if there is no log file or
+     *  rotation failed.
+     */
+    bool log_file_rotate_now();
+
+    /** Switches compression of rotated generations on/off. Generations are
+     *  gzipped (filename.N.gz) one by one in a background thread running at
+     *  the lowest CPU and I/O priority; it reads at most rate bytes per
+     *  second (0: unlimited) and never holds up writers or rotation. The
+     *  oldest generations are removed once all of them together exceed
+     *  budget bytes (0: no limit). Returns false if not available (built
+     *  without zlib).
+     */
+    bool log_file_compress(bool value = true
+                           , std::uint64_t rate = DefaultCompressRate
+                           , std::uint64_t budget = 0);
+
+    /** Switches block compressed output on (blockSize > 0) or off (0).
+     *  Lines are collected into blocks of about blockSize bytes, each one
+     *  is written as an independent gzip member (the file as a whole stays
+     *  valid gzip) and described in sidecar index filename.idx by its
+     *  offset, size, time of its first line and levels of its lines (see
+     *  detail/blocks.hpp), i.e. readers can pick blocks by time without
+     *  decompressing the whole file. Blocks are written like buffered
+     *  lines: when full, flushInterval milliseconds after the first line,
+     *  before an urgent line or on flush_file(); full blocks are compressed
+     *  by the flush thread, not the logging one. Replaces buffered output
+     *  and cannot be combined with memory mapped output. Tied descriptors
+     *  must not write into the file. Rotated generations keep their index
+     *  (filename.N.idx) and are not compressed again. Returns false if not
+     *  available (built without zlib).
+     */
+    bool log_file_blocks(std::size_t blockSize = DefaultBlockSize
+                         , unsigned int flushInterval
+                         = DefaultFlushInterval);
+
+    static const unsigned int DefaultFlushInterval = 1000;
+
+    static const unsigned int DefaultRotateKeep = 5;
+
+    static const std::size_t DefaultMmapChunkSize = 16 << 20;
+
+    static const std::uint64_t DefaultCompressRate = 8 << 20;
+
+    static const std::size_t DefaultBlockSize = 64 << 10;
+
 protected:
-    bool write_file(const std::string &line) {
-        return write_file(line.data(), line.size());
+    bool write_file(const std::string &line, bool urgent = false
+                    , level l = none, const timestamp *time = nullptr)
+    {
+        return write_file(line.data(), line.size(), urgent, l, time);
     }
 
-    bool write_file(const char *data, size_t left);
+    /** Writes data to log file. In buffered mode data are buffered unless
+     *  urgent is set; urgent data are written (after buffered lines)
+     *  immediately. Level and time (nullptr: now) of the data are recorded
+     *  in block index.
+     */
+    bool write_file(const char *data, size_t left, bool urgent = false
+                    , level l = none, const timestamp *time = nullptr);
 
     bool use_file() const { return use_file_; }
 
@@ -104,10 +213,168 @@ private:
 
     bool use_file_; //!< Log to configured file
     std::string filename_; //!< log file filename
+    ::mode_t mode_; //!< log file creation mode
     int fd_; //!< fd associated with output file
 
     boost::mutex m_;
     std::set<int> ties_;
+
+#ifndef _WIN32
+    /** Writes buffered lines followed by data, bufferLock_ must be held.
+     */
+    void flush_buffer(const char *data = nullptr, size_t size = 0);
+
+    void flusher();
+
+    void stop_flusher();
+
+    /** Buffer size, 0 means unbuffered output.
+     */
+    std::atomic<std::size_t> bufferSize_;
+    unsigned int flushInterval_;
+
+    std::string buffer_;
+
+    /** Time of first line in buffer.
+     */
+    boost::posix_time::ptime bufferStart_;
+
+    boost::mutex bufferLock_;
+    boost::condition_variable flusherWakeup_;
+    bool flusherRunning_;
+    boost::thread flusher_;
+
+    /** io_uring writer, created on first use and kept until destruction;
+     *  fd_ never changes (log files are dup2'd onto it).
+     */
+    std::unique_ptr<detail::uring_writer> uring_;
+    std::atomic<bool> useUring_;
+
+    /** Writes data via uring_ or directly.
+     */
+    void write_data(const char *data, size_t left, bool urgent);
+
+    /** Memory mapped writer, created on first use; mmapChunkSize_ is
+     *  non-zero when switched on, useMmap_ when file is mapped.
+     */
+    std::unique_ptr<detail::mmap_writer> mmap_;
+    std::atomic<bool> useMmap_;
+    std::size_t mmapChunkSize_;
+
+    /** Handles failed mapped write: retries under lock (file could have
+     *  been reopened meanwhile) or switches mapped output off.
+     */
+    bool mmap_retry(const char *data, size_t left);
+
+    /** (Re)maps current file if mapped output is on, m_ must be held.
+     */
+    void mmap_open();
+
+    /** Counts data written to current file, wakes rotator up once size
+     *  limit is reached.
+     */
+    void count_written(std::size_t size);
+
+    /** Renames current file to first generation and opens new one, m_ must
+     *  be held.
+     */
+    bool rotate();
+
+    void rotator();
+
+    void stop_rotator();
+
+    /** Bytes written to current file (tracked only while size limit is
+     *  set).
+     */
+    std::atomic<std::uint64_t> written_;
+
+    /** Rotation size limit, 0 means none.
+     */
+    std::atomic<std::uint64_t> rotateSize_;
+    unsigned int rotateInterval_;
+    std::atomic<unsigned int> rotateKeep_;
+
+    /** Set by the writer reaching size limit, cleared after rotation.
+     */
+    std::atomic<bool> rotatePending_;
+
+    boost::mutex rotateLock_;
+    boost::condition_variable rotateWakeup_;
+    bool rotatorRunning_;
+    boost::thread rotator_;
+
+    /** Held while generations are renamed or removed (rotation vs
+     *  compressor).
+     */
+    boost::mutex generationLock_;
+
+    /** Compressor of rotated generations, exists only while switched on.
+     */
+    std::unique_ptr<detail::compressor> compressor_;
+
+    /** Opens index of current log file (or /dev/null) in place of
+     *  indexFd_; m_ and bufferLock_ must be held, no block in progress
+     *  (see wait_blocks).
+     */
+    bool open_index();
+
+    /** Hands full buffer over to the flusher as sealed block (waits while
+     *  the previous one has not been taken yet), bufferLock_ must be held.
+     */
+    void seal_block();
+
+    /** Waits until sealed block is taken by the flusher (all: and every
+     *  block is written); writes it itself when the flusher is not
+     *  running. bufferLock_ must be held.
+     */
+    void wait_blocks(bool all);
+
+    /** Compresses sealed block and writes it along with its index entry,
+     *  bufferLock_ must be held; guard (if any) is unlocked meanwhile.
+     */
+    void write_block(boost::mutex::scoped_lock *guard);
+
+    /** Block output is on; buffer_ collects lines of current block then.
+     */
+    std::atomic<bool> blocks_;
+    std::unique_ptr<detail::block_compressor> blockCompressor_;
+
+    /** Raw and compressed block being written (kept to reuse their
+     *  memory); touched only by the block writer (compressing_).
+     */
+    std::string raw_;
+    std::string block_;
+
+    /** Time of first line and levels of all lines in buffer.
+     */
+    timestamp blockTime_;
+    unsigned int blockLevels_;
+
+    /** Full block waiting for the flusher, with its time and levels.
+     */
+    std::string sealed_;
+    timestamp sealedTime_;
+    unsigned int sealedLevels_;
+
+    /** Block is being compressed and written outside bufferLock_.
+     */
+    bool compressing_;
+
+    /** Signalled when sealed block is taken and when block is written;
+     *  waited on with bufferLock_ alone.
+     */
+    boost::condition_variable_any blockDone_;
+
+    /** Offset of next block in log file.
+     */
+    std::uint64_t blockOffset_;
+
+    /** Index descriptor, index files are dup2'd onto it; -1 until block
+     *  output is switched on for the first time.
+     */
+    int indexFd_;
+#endif
 };
 
 } // namespace dbglog
@@ -30,6 +30,7 @@
 #include <string>
 #include <iostream>
 #include <atomic>
+#include <memory>
 
 #include <boost/noncopyable.hpp>
 #include <boost/thread.hpp>
@@ -43,90 +44,178 @@
 #include "location.hpp"
 #include "mask.hpp"
 #include "detail/log_helpers.hpp"
+#include "detail/async.hpp"
+#include "detail/line_buffer.hpp"
+#include "detail/format.hpp"
+#include "detail/binary.hpp"
+#include "detail/rcu.hpp"
+#include "detail/repeat.hpp"
+#include "detail/sanitize.hpp"
 
 #include "logfile.hpp"
 #include "sink.hpp"
+#include "record.hpp"
 
 namespace dbglog {
 
-class logger : public logger_file {
+class module;
+
+namespace detail {
+
+/** Modules of one logger. Shared by logger and its modules: a module may
+ *  outlive its logger (static destruction order).
+ */
+struct module_registry : boost::noncopyable {
+    boost::mutex lock;
+    std::vector<const module*> modules;
+};
+
+} // namespace detail
+
+class logger : public logger_file, private Sink::mask_listener {
 public:
     logger(unsigned int mask)
-        : logger_file(), mask_(~mask), show_threads_(true), show_pid_(true)
-        , time_precision_(0), use_console_(true)
+        : logger_file(), config_(new config(mask)), any_mask_(~mask)
+        , sinks_mask_(0)
+        , modules_(std::make_shared<detail::module_registry>())
+        , async_([this](const record &r, bool own)
+                 {
+                     dispatch(r, own);
+                 })
+        , repeats_([this](const detail::repeat_filter::last_line &last)
+                   {
+                       detail::scoped_line_stream linePrefix;
+                       detail::line_format format;
+                       {
+                           config_reader c(config_);
+                           format = c->line_format();
+                           *linePrefix << c->line_prefix;
+                       }
+                       format.line_prefix = &linePrefix->str();
+                       report_repeated(format, last);
+                   })
     {
     }
 
-    ~logger() {}
+    ~logger() {
+        // pending repetitions go out while outputs are still alive
+        repeats_.timeout(0);
+        shutdown();
+        for (const auto &sink : sinks_.get()) { sink->remove_listener(this); }
+    }
 
     // for documentation purposes:
     using logger_file::log_file;
+    using logger_file::log_file_buffer;
+    using logger_file::log_file_uring;
+    using logger_file::log_file_mmap;
     using logger_file::tie;
     using logger_file::untie;
 
-    // NB: not threads safe; this must be done before any new thread is created!
+    /** Sink list is replaced as a whole, logging threads never wait for
+     *  it. Thread safe, but must not be called from Sink::write. Returns
+     *  after no thread can use removed sinks anymore.
+     */
     void addSink(const Sink::pointer &sink) {
-        sinks_.push_back(sink);
         if (sink->shared_mask()) { sink->set_mask(get_mask()); }
+        sink->add_listener(this);
+
+        {
+            boost::mutex::scoped_lock guard(sinksLock_);
+            std::unique_ptr<Sink::list> sinks(new Sink::list(sinks_.get()));
+            sinks->push_back(sink);
+            sinks_.publish(std::move(sinks));
+        }
+        update_any_mask();
     }
 
-    // NB: not threads safe; this must be done before any new thread is created!
     void removeSink(const Sink::pointer &sink) {
-        // try to remove given sink
-        sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), sink)
-                     , sinks_.end());
+        std::size_t removed(0);
+        {
+            boost::mutex::scoped_lock guard(sinksLock_);
+            // try to remove given sink
+            std::unique_ptr<Sink::list> sinks(new Sink::list(sinks_.get()));
+            const auto end(std::remove(sinks->begin(), sinks->end(), sink));
+            removed = sinks->end() - end;
+            sinks->erase(end, sinks->end());
+            sinks_.publish(std::move(sinks));
+        }
+        update_any_mask();
+        while (removed--) { sink->remove_listener(this); }
     }
 
-    // NB: not threads safe; this must be done before any new thread is created!
     void clearSinks() {
-        sinks_.clear();
+        Sink::list old;
+        {
+            boost::mutex::scoped_lock guard(sinksLock_);
+            old = sinks_.get();
+            sinks_.publish(std::unique_ptr<Sink::list>(new Sink::list()));
+        }
+        update_any_mask();
+        for (const auto &sink : old) { sink->remove_listener(this); }
     }
 
     bool log(level l, const std::string &message
-             , const location &loc)
+             , const location &loc, const field_set *fields = nullptr)
     {
-        return prefix_log(l, empty_, message, loc);
+        return prefix_log(l, empty_, message, loc, fields);
     }
 
     bool prefix_log(level l, const std::string &prefix
                     , const std::string &message
-                    , const location &loc)
+                    , const location &loc
+                    , const field_set *fields = nullptr)
     {
         if (!check_level(l)) {
             return false;
         }
 
-        std::ostringstream os;
-        line_prefix(os, l);
-        if (!prefix.empty()){
-            os << prefix << ' ';
-        }
-        os << message << ' ' << loc << '\n';
+        return log_line(l, nullptr, prefix, message, loc, fields);
+    }
 
-        const auto line(os.str());
+    /** Logs line of call site forced on (see callsite_state::on): own output
+     *  ignores mask, sinks still use their own masks.
+     */
+    bool log_forced(level l, const std::string &message
+                    , const location &loc
+                    , const field_set *fields = nullptr)
+    {
+        return log_line(l, &forcedMask_, empty_, message, loc, fields);
+    }
 
-        if (check_level_(l)) {
-            write(line);
-        }
+    template <typename ...Args>
+    bool log_binary(detail::binary_callsite &site, const char *format
+                    , Args &&...args)
+    {
+        return prefix_log_binary(site, empty_, format
+                                 , std::forward<Args>(args)...);
+    }
 
-        for (auto &sink : sinks_) {
-            if (sink->check_level(l)) { sink->write(line); }
+    /** Logs LOGB line. With binary log file on, only a binary record is
+     *  written instead of log file and console output; text is rendered
+     *  only for sinks that want it. Otherwise the line is logged as
+     *  LOG(l)(format, args...).
+     */
+    template <typename ...Args>
+    bool prefix_log_binary(detail::binary_callsite &site
+                           , const std::string &prefix, const char *format
+                           , Args &&...args)
+    {
+        if (!check_level(site.l)) {
+            return false;
         }
 
-        return true;
+        return log_binary_line(site, nullptr, prefix, format
+                               , std::forward<Args>(args)...);
     }
 
+    /** Checks whether anyone (logger itself or any sink) wants given
+     *  level. Uses combined mask of all destinations, i.e. it is one load
+     *  and one AND.
+     */
     inline bool check_level(level l) const {
-        if (!(mask_ & l) || (l == fatal)) {
-            return true;
-        }
-
-        for (const auto &sink : sinks_) {
-            if (sink->check_level(l)) {
-                return true;
-            }
-        }
-        return false;
+        return !(any_mask_.load(std::memory_order_relaxed) & l)
+            || (l == fatal);
     }
 
     inline bool check_level(level l, std::atomic<bool> &guard) const {
@@ -138,146 +227,619 @@ public:
         return check_level(l);
     }
 
+    /** Settings below are kept in an immutable snapshot replaced as a
+     *  whole: they can be changed any time from any thread, logging threads
+     *  never wait and always see one consistent configuration per line.
+     *  Must not be called from Sink::write.
+     */
     void log_thread(bool value = true) {
-        show_threads_ = value;
+        reconfigure([&](config &c) { c.show_threads = value; });
     }
 
     void log_pid(bool value = true) {
-        show_pid_ = value;
+        reconfigure([&](config &c) { c.show_pid = value; });
     }
 
     void log_console(bool value = true) {
-        use_console_ = value;
+        reconfigure([&](config &c) { c.use_console = value; });
+    }
+
+    /** Escapes newlines and other control characters (except tab) in
+     *  messages as \n, \r or \xHH, i.e. logged data can neither break nor
+     *  forge log lines. Clean messages are only scanned (SIMD).
+     */
+    void log_sanitize(bool value = true) {
+        reconfigure([&](config &c) { c.sanitize = value; });
+    }
+
+    bool get_log_sanitize() const {
+        return config_reader(config_)->sanitize;
     }
 
-    bool get_log_console() { return use_console_ ; }
+    bool get_log_console() { return config_reader(config_)->use_console; }
 
+    /** Sets logger mask including per-module overrides. Modules pick up
+     *  their masks immediately.
+     */
     void set_mask(const mask &m) {
-        mask_ = ~m.get();
-        for (const auto &sink : sinks_) {
-            if (sink->shared_mask()) { sink->set_mask(m); }
+        reconfigure([&](config &c) {
+                c.mask = ~m.get();
+                c.full_mask = m;
+            });
+
+        {
+            sinks_reader sinks(sinks_);
+            for (const auto &sink : *sinks) {
+                if (sink->shared_mask()) { sink->set_mask(m); }
+            }
         }
+        update_any_mask();
     }
 
     void set_mask(unsigned int m) {
-        mask_ = ~m;
-
-        for (const auto &sink : sinks_) {
-            if (sink->shared_mask()) { sink->set_mask(m); }
-        }
+        set_mask(mask(m));
     }
 
+    /** Returns base mask (without module overrides).
+     */
     unsigned int get_mask() const {
-        return ~mask_;
+        return ~config_reader(config_)->mask;
     }
 
     std::string get_mask_string() const {
-        return mask(~mask_).as_string();
+        return config_reader(config_)->full_mask.as_string();
     }
 
     unsigned short log_time_precision() const {
-        return time_precision_;
+        return config_reader(config_)->time_precision;
     }
 
     void log_time_precision(unsigned short time_precision) {
-        time_precision_ = time_precision;
+        reconfigure([&](config &c) { c.time_precision = time_precision; });
     }
 
+    /** Collapses repeated lines (per thread): first one is logged, its
+     *  repetitions are reported as "last message repeated N times" once the
+     *  thread logs another line or timeout (ms) since the first one expires
+     *  (by a background thread if the thread stays quiet or exits). Zero
+     *  timeout switches collapsing off.
+     */
+    void log_collapse_repeated(unsigned int timeout = DefaultRepeatTimeout) {
+        reconfigure([&](config &c) { c.repeat_timeout = timeout; });
+        repeats_.timeout(std::int64_t(timeout) * 1000000);
+    }
+
+    static const unsigned int DefaultRepeatTimeout = 30000;
+
     void set_prefix(const std::string &prefix = "") {
-        line_prefix_ = prefix;
+        reconfigure([&](config &c) { c.line_prefix = prefix; });
     }
 
-    const std::string& get_prefix() const {
-        return line_prefix_;
+    std::string get_prefix() const {
+        return config_reader(config_)->line_prefix;
     }
 
+    /** Switches asynchronous logging on/off. In asynchronous mode log lines
+     *  are queued in per-thread rings (queueSize lines per severity lane)
+     *  and written to log file, console and sinks by a background thread.
+     *  Lines of levels in shed mask are dropped when their lane is full,
+     *  other lines wait. Switching while other threads log is safe (the
+     *  writer is stopped and restarted in place); concurrent calls of
+     *  log_async itself are not.
+     */
+    void log_async(bool value = true
+                   , std::size_t queueSize = DefaultAsyncQueueSize
+                   , const mask &shed = mask(none))
+    {
+        if (!value) {
+            shutdown();
+            return;
+        }
+
+        async_.start(queueSize, shed.get());
+    }
+
+    bool get_log_async() const { return async_.running(); }
+
+    /** Returns counters of given asynchronous severity lane.
+     */
+    async_lane_stats async_stats(async_lane lane) const {
+        return async_.stats(lane);
+    }
+
+    /** Waits until all lines queued in asynchronous mode are written and
+     *  writes buffered log file lines.
+     */
+    void flush() {
+        async_.flush();
+        flush_file();
+    }
+
+    /** Drains queued lines and stops asynchronous writer. Logging continues
+     *  synchronously.
+     */
+    void shutdown() {
+        async_.shutdown();
+    }
+
+    static const std::size_t DefaultAsyncQueueSize = 1024;
+
+    /** Opens binary log file for LOGB lines (deferred formatting, see
+     *  dbglog-decode); empty filename switches binary logging off. Binary
+     *  records are written synchronously even in asynchronous mode.
+     */
+    bool log_binary_file(const std::string &filename) {
+        return binary_.open(filename);
+    }
+
+    bool get_log_binary() const { return binary_.active(); }
+
 private:
-    inline bool check_level_(level l) const {
-        return !(mask_ & l) || (l == fatal);
+    friend class module;
+
+    typedef detail::rcu_ptr<Sink::list>::reader sinks_reader;
+
+    static bool check_level(unsigned int negMask, level l) {
+        return !(negMask & l) || (l == fatal);
+    }
+
+    /** Runtime configuration, immutable once published.
+     */
+    struct config {
+        config(unsigned int m)
+            : mask(~m), full_mask(m), show_threads(true), show_pid(true)
+            , time_precision(0), use_console(true), repeat_timeout(0)
+            , sanitize(false)
+        {}
+
+        bool check_level(level l) const {
+            return logger::check_level(mask, l);
+        }
+
+        unsigned int mask; //!< Log mask (negated base mask)
+        dbglog::mask full_mask; //!< Log mask with module overrides
+        bool show_threads; //!< Output thread ID (after PID)
+        bool show_pid; //!< Output PID of current process
+        unsigned short time_precision;
+
+        bool use_console; //!< Log to console (stderr)
+
+        /** Repeated lines collapsing timeout (ms), 0 = off.
+         */
+        unsigned int repeat_timeout;
+
+        /** Escape control characters in messages.
+         */
+        bool sanitize;
+
+        /** Line prefix added before message.
+         */
+        std::string line_prefix;
+
+        /** Text line layout; line prefix refers to this configuration.
+         */
+        detail::line_format line_format() const {
+            return { time_precision, show_pid, show_threads, &line_prefix };
+        }
+    };
+
+    typedef detail::rcu_ptr<config>::reader config_reader;
+
+    /** Publishes modified copy of current configuration.
+     */
+    template <typename Modify>
+    void reconfigure(const Modify &modify) {
+        boost::mutex::scoped_lock guard(configLock_);
+        std::unique_ptr<config> c(new config(config_.get()));
+        modify(*c);
+        config_.publish(std::move(c));
     }
 
-    void line_prefix(std::ostream &os, level l) {
-        detail::timebuffer now;
-        os << detail::format_time(now, time_precision_) << ' '
-           << detail::level2string(l);
-        os << line_prefix_;
+    virtual void sink_mask_changed() { update_any_mask(); }
 
-        if (show_pid_) {
-            os << " [" << detail::processId();
-            if (show_threads_) {
-                os << '(' << detail::thread_id::get() << ')';
-            }
-            os << ']';
-        } else if (show_threads_) {
-            os << " [(" << detail::thread_id::get() << ")]";
+    /** Recomputes any_mask_ and module masks from current logger and sink
+     *  masks. Serialized, every change is followed by an update, i.e. last
+     *  update sees all.
+     */
+    void update_any_mask();
+
+    /** Module registration, masks of registered module are kept up to date.
+     */
+    void register_module(const module *m);
+
+    /** Formats line and hands it over to outputs. Own output (log file and
+     *  console) uses negated ownMask if given (module) or logger mask.
+     */
+    bool log_line(level l, const unsigned int *ownMask
+                  , const std::string &prefix, const std::string &message
+                  , const location &loc, const field_set *fields = nullptr)
+    {
+        // configured line prefix is copied: record outlives read section
+        detail::scoped_line_stream linePrefix;
+        detail::line_format format;
+        bool own;
+        bool sanitize;
+        std::int64_t repeatTimeout;
+        {
+            config_reader c(config_);
+            own = check_level(ownMask ? *ownMask : c->mask, l);
+            sanitize = c->sanitize;
+            repeatTimeout = std::int64_t(c->repeat_timeout) * 1000000;
+            format = c->line_format();
+            *linePrefix << c->line_prefix;
+        }
+        format.line_prefix = &linePrefix->str();
+
+        // summary goes out after leaving read section: output can block
+        if (repeatTimeout
+            && repeats_.repeated
+            (l, own, prefix, message, loc, repeatTimeout
+             , [&](const detail::repeat_filter::last_line &last) {
+                report_repeated(format, last);
+            }))
+        {
+            return true;
         }
 
-        os << ": ";
+        if (sanitize
+            && (detail::find_escape(message.data(), message.size()
+                                    , detail::escape_mode::text)
+                != message.size()))
+        {
+            detail::scoped_line_stream escaped;
+            detail::write_escaped(*escaped, message.data(), message.size()
+                                  , detail::escape_mode::text);
+            emit(l, own, prefix, escaped->str(), loc, format, fields);
+        } else {
+            emit(l, own, prefix, message, loc, format, fields);
+        }
+        return true;
     }
 
-    void write(const std::string &line) {
-        if (use_console_) {
+    /** Builds record of final message and hands it over to outputs.
+     */
+    void emit(level l, bool own, const std::string &prefix
+              , const std::string &message, const location &loc
+              , const detail::line_format &format, const field_set *fields)
+    {
+        detail::scoped_line_stream text;
+        const record r(l, detail::current_time(format.time_precision)
+                       , detail::processId(), detail::thread_id::get()
+                       , prefix, message, loc, format, *text
+                       , fields ? *fields : field_set::none());
+        output(r, own);
+    }
+
+    /** Hands record over to async writer or dispatches it.
+     */
+    void output(const record &r, bool own) {
+        if (async_.started() && !detail::async_writer::in_writer()) {
+            async_.push(r, own);
+            // make sure fatal line hits the disk before we die
+            if (r.l == fatal) { async_.flush(); }
+            return;
+        }
+
+        dispatch(r, own);
+    }
+
+    /** Logs "last message repeated N times" for given last line (on behalf
+     *  of its thread) using format copied out of configuration.
+     */
+    void report_repeated(const detail::line_format &format
+                         , const detail::repeat_filter::last_line &last)
+    {
+        detail::scoped_line_stream message;
+        *message << "last message repeated " << last.count << " times";
+        detail::scoped_line_stream text;
+        const record r(last.l, detail::current_time(format.time_precision)
+                       , detail::processId(), last.thread
+                       , last.prefix, message->str(), last.loc, format
+                       , *text);
+        output(r, last.own);
+    }
+
+    /** Binary counterpart of log_line.
+     */
+    template <typename ...Args>
+    bool log_binary_line(detail::binary_callsite &site
+                         , const unsigned int *ownMask
+                         , const std::string &prefix, const char *format
+                         , Args &&...args)
+    {
+        const auto l(site.l);
+        if (!binary_.active()) {
+            detail::scoped_line_stream message;
+            detail::formatTo(*message, format, std::forward<Args>(args)...);
+            return log_line(l, ownMask, prefix, message->str(), site.loc);
+        }
+
+        if (check_level(ownMask ? *ownMask : config_reader(config_)->mask
+                        , l))
+        {
+            binary_.write(site, prefix, format, args...);
+        }
+
+        sinks_reader sinks(sinks_);
+        bool any(false);
+        for (const auto &sink : *sinks) {
+            if (sink->check_level(l)) { any = true; break; }
+        }
+        if (!any) { return true; }
+
+        detail::scoped_line_stream message;
+        detail::formatTo(*message, format, std::forward<Args>(args)...);
+        detail::scoped_line_stream linePrefix;
+        auto lineFormat([&]() -> detail::line_format {
+                config_reader c(config_);
+                *linePrefix << c->line_prefix;
+                return c->line_format();
+            }());
+        lineFormat.line_prefix = &linePrefix->str();
+
+        detail::scoped_line_stream text;
+        const record r(l, detail::current_time(lineFormat.time_precision)
+                       , detail::processId(), detail::thread_id::get()
+                       , prefix, message->str(), site.loc, lineFormat
+                       , *text);
+        for (auto &sink : *sinks) {
+            if (sink->check_level(l)) { sink->write_record(r); }
+        }
+        return true;
+    }
+
+
+
+    void write(level l, const timestamp &time, const std::string &line
+               , bool console)
+    {
+        if (console) {
             std::cerr.write(line.data(), line.size());
         }
 
-        logger_file::write_file(line);
+        // errors must not wait in the file buffer
+        logger_file::write_file(line, (l & (err1 | fatal)) != 0, l, &time);
+    }
+
+    void dispatch(const record &r, bool own) {
+        if (own) {
+            // text line is rendered only if someone reads it
+            const bool console(config_reader(config_)->use_console);
+            if (console || use_file()) {
+                write(r.l, r.time, r.line(), console);
+            }
+        }
+
+        sinks_reader sinks(sinks_);
+        for (auto &sink : *sinks) {
+            if (sink->check_level(r.l)) { sink->write_record(r); }
+        }
     }
 
-    unsigned int mask_; //!< Log mask
-    bool show_threads_; //!< Output thread ID (after PID)
-    bool show_pid_; //!< Output PID of current process
-    unsigned short time_precision_;
+    /** Current configuration, read without locking; configLock_
+     *  serializes modifications.
+     */
+    detail::rcu_ptr<config> config_;
+    boost::mutex configLock_;
 
-    bool use_console_; //!< Log to console (stderr)
+    /** Combined mask of logger and all sinks (a level passes it if each of
+     *  its bits is wanted by some destination, i.e. it can let through a
+     *  level nobody wants with unusual masks; destinations check anyway).
+     */
+    std::atomic<unsigned int> any_mask_;
+    boost::mutex anyMaskLock_;
 
-    /** Line prefix added before message.
+    /** Combined mask of all sinks, guarded by anyMaskLock_.
      */
-    std::string line_prefix_;
+    unsigned int sinks_mask_;
 
-    Sink::list sinks_;
+    std::shared_ptr<detail::module_registry> modules_;
+
+    /** Attached sinks, read without locking; sinksLock_ serializes
+     *  modifications.
+     */
+    detail::rcu_ptr<Sink::list> sinks_;
+    boost::mutex sinksLock_;
+
+    /** Asynchronous writer, running in asynchronous mode. Lives as long as
+     *  the logger: logging threads use it without any synchronization.
+     */
+    detail::async_writer async_;
+
+    /** Binary log file for LOGB lines.
+     */
+    detail::binary_file binary_;
+
+    /** Per-thread last lines for repeated lines collapsing.
+     */
+    detail::repeat_filter repeats_;
 
     static const std::string empty_;
+
+    /** Negated mask letting everything through.
+     */
+    static const unsigned int forcedMask_;
 };
 
+/** Named part of application with its own log mask (see mask: module
+ *  overrides apply to module and its submodules).
+ *
+ *  Module's resolved mask is cached in the module (updated by its logger on
+ *  every mask change), i.e. level check is a single load. Module registers
+ *  with its logger on first use, not on construction: a namespace scope
+ *  module can be constructed before its logger.
+ */
 class module {
 public:
     module(logger &sink)
-        : name_(), log_name_(), sink_(&sink)
-    {
-    }
+        : name_(), log_name_(), sink_(&sink), registered_(false)
+        , mask_(Unregistered), any_mask_(Unregistered)
+    {}
 
     module(const std::string &name, logger &sink)
         : name_(name), log_name_("[" + name + "]"), sink_(&sink)
-    {
-    }
+        , registered_(false), mask_(Unregistered), any_mask_(Unregistered)
+    {}
 
     module(const std::string &name, const module &other)
         : name_(other.name_ + "/" + name)
         , log_name_("[" + other.name_ + "/" + name + "]")
-        , sink_(other.sink_)
-    {
+        , sink_(other.sink_), registered_(false), mask_(Unregistered)
+        , any_mask_(Unregistered)
+    {}
+
+    module(const module &other)
+        : name_(other.name_), log_name_(other.log_name_), sink_(other.sink_)
+        , registered_(false), mask_(Unregistered), any_mask_(Unregistered)
+    {}
+
+    module& operator=(const module &other) {
+        if (this == &other) { return *this; }
+        unregister();
+        name_ = other.name_;
+        log_name_ = other.log_name_;
+        sink_ = other.sink_;
+        return *this;
     }
 
+    ~module() { unregister(); }
+
     bool check_level(level l) const {
-        return sink_->check_level(l);
+        const auto m(any_mask_.load(std::memory_order_relaxed));
+        if (!(m & l) || (l == fatal)) { return true; }
+        // unregistered module looks like one with everything off
+        if (m != Unregistered) { return false; }
+        ensure_registered();
+        return check_level(l);
     }
 
     bool check_level(level l, std::atomic<bool> &guard) const {
-        return sink_->check_level(l, guard);
+        bool exp_val = false;
+        bool new_val = true;
+        if (!std::atomic_compare_exchange_strong(&guard, &exp_val, new_val)) {
+            return false;
+        }
+        return check_level(l);
     }
 
     bool log(level l, const std::string &message
-             , const location &loc)
+             , const location &loc, const field_set *fields = nullptr)
+    {
+        ensure_registered();
+        const unsigned int m(mask_.load(std::memory_order_relaxed));
+        return sink_->log_line(l, &m, log_name_, message, loc, fields);
+    }
+
+    bool log_forced(level l, const std::string &message
+                    , const location &loc
+                    , const field_set *fields = nullptr)
     {
-        return sink_->prefix_log(l, log_name_, message, loc);
+        ensure_registered();
+        return sink_->log_line(l, &logger::forcedMask_, log_name_, message
+                               , loc, fields);
     }
 
+    template <typename ...Args>
+    bool log_binary(detail::binary_callsite &site, const char *format
+                    , Args &&...args)
+    {
+        ensure_registered();
+        const unsigned int m(mask_.load(std::memory_order_relaxed));
+        return sink_->log_binary_line(site, &m, log_name_, format
+                                      , std::forward<Args>(args)...);
+    }
+
+    const std::string& name() const { return name_; }
+
 private:
+    friend class logger;
+
+    void ensure_registered() const {
+        if (!registered_.load(std::memory_order_acquire)) {
+            sink_->register_module(this);
+        }
+    }
+
+    void unregister() {
+        if (!registered_.load(std::memory_order_acquire)) { return; }
+        {
+            boost::mutex::scoped_lock guard(registry_->lock);
+            auto &modules(registry_->modules);
+            modules.erase(std::remove(modules.begin(), modules.end(), this)
+                          , modules.end());
+        }
+        registry_.reset();
+        registered_ = false;
+        any_mask_ = Unregistered;
+    }
+
+    /** Called by logger with registry locked. Masks keep bits above level
+     *  bits clear, i.e. never equal Unregistered.
+     */
+    void update_masks(unsigned int m, unsigned int sinksMask) const {
+        mask_.store(~m & all, std::memory_order_relaxed);
+        any_mask_.store(~(m | sinksMask) & all, std::memory_order_relaxed);
+    }
+
+    /** Masks of module not registered yet: every level off, bits outside
+     *  levels set.
+     */
+    static const unsigned int Unregistered = ~0u;
+
     std::string name_;
     std::string log_name_;
     logger *sink_;
+
+    /** Set once registered (masks are valid), under logger's anyMaskLock_.
+     */
+    mutable std::atomic<bool> registered_;
+
+    /** Registry this module is registered in, keeps it alive.
+     */
+    mutable std::shared_ptr<detail::module_registry> registry_;
+
+    /** Module's own mask (negated), for log file and console.
+     */
+    mutable std::atomic<unsigned int> mask_;
+
+    /** Module's mask combined with all sinks' masks (negated).
+     */
+    mutable std::atomic<unsigned int> any_mask_;
 };
 
+inline void logger::update_any_mask()
+{
+    boost::mutex::scoped_lock guard(anyMaskLock_);
+    const auto full(config_reader(config_)->full_mask);
+    unsigned int m(0);
+    {
+        sinks_reader sinks(sinks_);
+        for (const auto &sink : *sinks) { m |= sink->get_mask(); }
+    }
+    sinks_mask_ = m;
+    any_mask_.store(~(full.get() | m), std::memory_order_relaxed);
+
+    boost::mutex::scoped_lock registryGuard(modules_->lock);
+    for (auto *module : modules_->modules) {
+        module->update_masks(full.get(module->name_), m);
+    }
+}
+
+inline void logger::register_module(const module *m)
+{
+    boost::mutex::scoped_lock guard(anyMaskLock_);
+    // another thread has been faster
+    if (m->registered_.load(std::memory_order_relaxed)) { return; }
+
+    m->registry_ = modules_;
+    m->update_masks(config_reader(config_)->full_mask.get(m->name_)
+                    , sinks_mask_);
+
+    boost::mutex::scoped_lock registryGuard(modules_->lock);
+    modules_->modules.push_back(m);
+    m->registered_.store(true, std::memory_order_release);
+}
+
 } // namespace dbglog
 
 #endif // shared_dbglog_logger_hpp_included_
@@ -32,6 +32,7 @@
 #include <boost/spirit/include/phoenix_operator.hpp>
 
 #include <stdexcept>
+#include <algorithm>
 
 namespace dbglog {
 
@@ -61,11 +62,8 @@ std::string mask2string(unsigned int mask, dbglog::level l)
     }
 }
 
-} // namespace detail
-
-std::string mask::as_string() const
+std::string levels2string(unsigned int m)
 {
-    unsigned int m(mask_);
     if (dbglog::none == m) {
         return "NONE";
     } else if (dbglog::all == m) {
@@ -79,7 +77,7 @@ std::string mask::as_string() const
          + detail::mask2string(m, dbglog::err1));
 }
 
-void mask::from_string(const std::string &str)
+unsigned int string2levels(const std::string &str)
 {
     using boost::spirit::qi::string;
     using boost::spirit::qi::char_;
@@ -130,7 +128,71 @@ void mask::from_string(const std::string &str)
         throw std::runtime_error("Bad mask syntax.");
     }
 
-    mask_ = m;
+    return m;
+}
+
+} // namespace detail
+
+std::string mask::as_string() const
+{
+    std::string str(detail::levels2string(mask_));
+    for (module_masks::const_iterator imodules(modules_.begin())
+             , emodules(modules_.end()); imodules != emodules; ++imodules)
+    {
+        str += "," + imodules->first + "="
+            + detail::levels2string(imodules->second);
+    }
+    return str;
+}
+
+unsigned int mask::get(const std::string &module) const
+{
+    if (modules_.empty()) { return mask_; }
+
+    // most specific module wins: "a/b/c", "a/b", "a"
+    std::string name(module);
+    for (;;) {
+        const module_masks::const_iterator fmodules(modules_.find(name));
+        if (fmodules != modules_.end()) { return fmodules->second; }
+
+        const std::string::size_type slash(name.rfind('/'));
+        if (slash == std::string::npos) { return mask_; }
+        name.resize(slash);
+    }
+}
+
+void mask::from_string(const std::string &str)
+{
+    // levels [, module=levels]*; base mask can be omitted
+    unsigned int base(dbglog::default_);
+    module_masks modules;
+
+    std::string::size_type start(0);
+    for (bool first(true); ; first = false) {
+        const std::string::size_type end
+            (std::min(str.find(',', start), str.size()));
+        const std::string item(str.substr(start, end - start));
+        const std::string::size_type eq(item.find('='));
+
+        if (eq == std::string::npos) {
+            if (!first) { throw std::runtime_error("Bad mask syntax."); }
+            base = detail::string2levels(item);
+        } else {
+            const std::string name(item.substr(0, eq));
+            if (name.empty()
+                || (name.find_first_of(" \t") != std::string::npos))
+            {
+                throw std::runtime_error("Bad mask syntax.");
+            }
+            modules[name] = detail::string2levels(item.substr(eq + 1));
+        }
+
+        if (end == str.size()) { break; }
+        start = end + 1;
+    }
+
+    mask_ = base;
+    modules_.swap(modules);
 }
 
 mask max(const mask &l, const mask &r)
@@ -27,14 +27,23 @@
 #define shared_dbglog_mask_hpp_included_
 
 #include <string>
+#include <map>
 #include <iosfwd>
 
 #include "level.hpp"
 
 namespace dbglog {
 
+/** Log mask: base mask and optional per-module overrides.
+ *
+ *  Module override applies to given module and all its submodules (module
+ *  names are paths: "db/sql" is submodule of "db"); the most specific one
+ *  wins.
+ */
 class mask {
 public:
+    typedef std::map<std::string, unsigned int> module_masks;
+
     mask(unsigned int m = default_) : mask_(m) {}
 
     mask(const std::string &m) { from_string(m); }
@@ -43,8 +52,20 @@ public:
 
     void from_string(const std::string &str);
 
+    /** Base mask.
+     */
     unsigned int get() const { return mask_; }
 
+    /** Mask resolved for given module.
+     */
+    unsigned int get(const std::string &module) const;
+
+    const module_masks& modules() const { return modules_; }
+
+    void set(const std::string &module, unsigned int m) {
+        modules_[module] = m;
+    }
+
     template<typename CharT, typename Traits>
     friend std::basic_ostream<CharT, Traits>&
     operator<<(std::basic_ostream<CharT, Traits> &os, const mask &m)
@@ -64,6 +85,7 @@ public:
 
 private:
     unsigned int mask_;
+    module_masks modules_;
 };
 
 mask (max)(const mask &l, const mask &r);
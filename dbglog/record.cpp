@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <utility>
+
+#include "record.hpp"
+#include "detail/line_buffer.hpp"
+#include "detail/log_helpers.hpp"
+
+namespace dbglog {
+
+const std::string& record::line() const
+{
+    if (rendered_) { return text_.str(); }
+
+    auto &os(text_);
+    detail::timebuffer b;
+    os << detail::format_time(b, time, format_.time_precision) << ' '
+       << detail::level2string(l);
+    os << *format_.line_prefix;
+
+    if (format_.show_pid) {
+        os << " [" << pid;
+        if (format_.show_threads) { os << '(' << thread << ')'; }
+        os << ']';
+    } else if (format_.show_threads) {
+        os << " [(" << thread << ")]";
+    }
+
+    os << ": ";
+    if (!module.empty()) { os << module << ' '; }
+    os << message;
+    for (const auto &f : fields) { os << ' ' << f.key << '=' << f; }
+    os << ' ' << loc << '\n';
+
+    rendered_ = true;
+    return text_.str();
+}
+
+namespace detail {
+
+record_copy::record_copy()
+    : l(none), time(), pid(0), loc(nullptr, nullptr, 0), format()
+{
+    format.line_prefix = &linePrefix;
+}
+
+void record_copy::assign(const record &r)
+{
+    l = r.l;
+    time = r.time;
+    pid = r.pid;
+    thread.assign(r.thread);
+    module.assign(r.module);
+    message.assign(r.message);
+    // deep copy, preformatted text is dropped
+    file.assign(r.loc.file ? r.loc.file : "");
+    func.assign(r.loc.func ? r.loc.func : "");
+    loc = location(r.loc.file ? file.c_str() : nullptr
+                   , r.loc.func ? func.c_str() : nullptr, r.loc.line);
+    linePrefix.assign(*r.format().line_prefix);
+    format.time_precision = r.format().time_precision;
+    format.show_pid = r.format().show_pid;
+    format.show_threads = r.format().show_threads;
+    fields.assign(r.fields);
+}
+
+void record_copy::swap(record_copy &other)
+{
+    std::swap(l, other.l);
+    std::swap(time, other.time);
+    std::swap(pid, other.pid);
+    thread.swap(other.thread);
+    module.swap(other.module);
+    message.swap(other.message);
+    std::swap(loc, other.loc);
+    file.swap(other.file);
+    func.swap(other.func);
+    relink();
+    other.relink();
+    linePrefix.swap(other.linePrefix);
+    std::swap(format.time_precision, other.format.time_precision);
+    std::swap(format.show_pid, other.format.show_pid);
+    std::swap(format.show_threads, other.format.show_threads);
+    fields.swap(other.fields);
+}
+
+void record_copy::relink()
+{
+    if (loc.file) { loc.file = file.c_str(); }
+    if (loc.func) { loc.func = func.c_str(); }
+}
+
+} // namespace detail
+
+} // namespace dbglog
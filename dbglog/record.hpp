@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef shared_dbglog_record_hpp_included_
+#define shared_dbglog_record_hpp_included_
+
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include "level.hpp"
+#include "location.hpp"
+#include "fields.hpp"
+#include "detail/time.hpp"
+
+namespace dbglog {
+
+namespace detail {
+
+class line_stream;
+struct record_copy;
+
+/** Text line layout, taken from logger's configuration.
+ */
+struct line_format {
+    unsigned short time_precision;
+    bool show_pid;
+    bool show_threads;
+    const std::string *line_prefix;
+};
+
+} // namespace detail
+
+/** One log record as passed to sinks. All fields refer to logger's data,
+ *  i.e. record is valid only during Sink::write_record call.
+ *
+ *  Text line (as written to log file) is rendered on first call of line()
+ *  and shared by all destinations of the record; not thread safe.
+ */
+class record : boost::noncopyable {
+public:
+    record(level l, const timestamp &time, int pid
+           , const std::string &thread, const std::string &module
+           , const std::string &message, const location &loc
+           , const detail::line_format &format, detail::line_stream &text
+           , const field_set &fields = field_set::none())
+        : l(l), time(time), pid(pid), thread(thread), module(module)
+        , message(message), loc(loc), fields(fields), format_(format)
+        , text_(text), rendered_(false)
+    {}
+
+    /** Record of stored copy (see detail::record_copy).
+     */
+    record(const detail::record_copy &copy, detail::line_stream &text);
+
+    const level l;
+    const timestamp time;
+    const int pid;
+
+    /** Thread identifier (see dbglog::thread_id).
+     */
+    const std::string &thread;
+
+    /** Module prefix (e.g. "[db/sql]"), empty if none.
+     */
+    const std::string &module;
+
+    const std::string &message;
+    const location &loc;
+
+    /** Structured fields (see stream::kv), empty if none.
+     */
+    const field_set &fields;
+
+    /** Rendered text line including trailing newline.
+     */
+    const std::string& line() const;
+
+    /** Returns true if text line has been rendered already.
+     */
+    bool rendered() const { return rendered_; }
+
+    /** Text line layout (for loggers passing the record on).
+     */
+    const detail::line_format& format() const { return format_; }
+
+private:
+    const detail::line_format &format_;
+    detail::line_stream &text_;
+    mutable bool rendered_;
+};
+
+namespace detail {
+
+/** Owning copy of a record for queues. Strings keep their memory, i.e. no
+ *  allocation once the copy is warm. Not copyable: format refers to own
+ *  line prefix and loc to own file and function names (location passed to
+ *  logger::log can be built from a temporary string).
+ */
+struct record_copy : boost::noncopyable {
+    level l;
+    timestamp time;
+    int pid;
+    std::string thread;
+    std::string module;
+    std::string message;
+    location loc;
+    std::string file;
+    std::string func;
+    std::string linePrefix;
+    line_format format;
+    field_set fields;
+
+    record_copy();
+
+    void assign(const record &r);
+
+    /** Exchanges contents with other copy (no allocation).
+     */
+    void swap(record_copy &other);
+
+private:
+    /** Points loc to own file and function names.
+     */
+    void relink();
+};
+
+} // namespace detail
+
+inline record::record(const detail::record_copy &copy
+                      , detail::line_stream &text)
+    : record(copy.l, copy.time, copy.pid, copy.thread, copy.module
+             , copy.message, copy.loc, copy.format, text, copy.fields)
+{}
+
+} // namespace dbglog
+
+#endif // shared_dbglog_record_hpp_included_
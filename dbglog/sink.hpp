@@ -31,10 +31,15 @@
 #include <vector>
 #include <utility>
 #include <memory>
+#include <atomic>
+#include <algorithm>
 
 #include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "level.hpp"
+#include "mask.hpp"
+#include "record.hpp"
 
 namespace dbglog {
 
@@ -51,16 +56,30 @@ public:
     virtual ~Sink() {}
 
     inline bool check_level(level l) const {
-        return !(mask_ & l) || (l == fatal);
+        return !(mask_.load(std::memory_order_relaxed) & l) || (l == fatal);
     }
 
+    /** Receives one log record. Default implementation passes rendered
+     *  text line to write(line); override this one to use record's fields
+     *  directly (text is then rendered only if some other destination
+     *  needs it).
+     */
+    virtual void write_record(const record &r) { write(r.line()); }
+
+    /** Receives one rendered text line (see write_record). Every sink
+     *  must handle plain lines, even one overriding write_record.
+     */
     virtual void write(const std::string &line) = 0;
 
     const std::string& name() const { return name_; }
 
-    void set_mask(const mask &m) {  mask_ = ~m.get();  }
+    void set_mask(const mask &m) { set_mask(m.get()); }
 
-    void set_mask(unsigned int m) { mask_ = ~m; }
+    void set_mask(unsigned int m) {
+        mask_ = ~m;
+        boost::mutex::scoped_lock guard(listenersLock_);
+        for (auto *listener : listeners_) { listener->sink_mask_changed(); }
+    }
 
     unsigned int get_mask() const { return ~mask_; }
 
@@ -72,6 +91,30 @@ public:
 
     void shared_mask(bool v) { shared_mask_ = v; }
 
+    /** Gets notified about mask changes (logger keeps its combined mask of
+     *  all destinations this way).
+     */
+    class mask_listener {
+    public:
+        virtual void sink_mask_changed() = 0;
+
+    protected:
+        ~mask_listener() {}
+    };
+
+    void add_listener(mask_listener *listener) {
+        boost::mutex::scoped_lock guard(listenersLock_);
+        listeners_.push_back(listener);
+    }
+
+    void remove_listener(mask_listener *listener) {
+        boost::mutex::scoped_lock guard(listenersLock_);
+        // remove one registration only (sink can be added more times)
+        auto ilisteners(std::find(listeners_.begin(), listeners_.end()
+                                  , listener));
+        if (ilisteners != listeners_.end()) { listeners_.erase(ilisteners); }
+    }
+
     /** Helper for appopriate pointer type creator.
      */
     template <typename SinkT, typename ...Args>
@@ -81,8 +124,11 @@ public:
 
 private:
     bool shared_mask_;
-    unsigned int mask_;
+    std::atomic<unsigned int> mask_; //!< may change while logging
     const std::string name_;
+
+    boost::mutex listenersLock_;
+    std::vector<mask_listener*> listeners_;
 };
 
 } // namespace dbglog
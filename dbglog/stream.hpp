@@ -28,6 +28,7 @@
 
 #include <utility>
 #include <cstddef>
+#include <cstdint>
 
 #include <boost/noncopyable.hpp>
 #include <boost/format.hpp>
@@ -37,49 +38,81 @@
 
 #include "dbglog/logger.hpp"
 #include "dbglog/level.hpp"
+#include "dbglog/config.hpp"
+#include "dbglog/callsite.hpp"
+#include "dbglog/fields.hpp"
 #include "dbglog/detail/log_helpers.hpp"
 #include "dbglog/detail/logger.hpp"
+#include "dbglog/detail/line_buffer.hpp"
+#include "dbglog/detail/format.hpp"
+#include "dbglog/detail/binary.hpp"
 
 namespace dbglog {
 
-namespace detail {
-
-inline void formatMessage(boost::format&) {}
-
-template <typename T, typename ...Args>
-inline void formatMessage(boost::format &fmt, T &&arg, Args &&...rest)
-{
-    fmt % arg;
-    return formatMessage(fmt, std::forward<Args>(rest)...);
-}
-
-} // namespace detail
-
 template <typename SinkType>
 class stream : public boost::noncopyable
 {
 public:
     stream(const location &loc, level l, SinkType &sink)
-        : loc_(loc), l_(l), sink_(sink)
+        : loc_(loc), l_(l), sink_(sink), site_(nullptr), force_(false)
+        , suppressed_(0)
+    {}
+
+    stream(const detail::callsite_check &check, level l, SinkType &sink)
+        : loc_(check.site.loc), l_(l), sink_(sink), site_(&check.site)
+        , force_(check.force), suppressed_(check.suppressed)
     {}
 
     ~stream() {
-        sink_.log(l_, os_.str(), loc_);
+        if (suppressed_) {
+            *os_ << " (suppressed " << suppressed_ << " messages)";
+        }
+        detail::log(sink_, l_, os_->str(), loc_, force_, fields_.get());
+    }
+
+    /** Adds structured field; value keeps its type (numbers, booleans,
+     *  strings), anything else is kept as its text.
+     */
+    template <typename T>
+    stream& kv(const char *key, const T &value)
+    {
+        detail::set_field((*fields_).add(key), value);
+        return *this;
     }
 
     template <typename T>
     std::basic_ostream<char>& operator<<(const T &t)
     {
-        return os_ << t;
+        return *os_ << t;
+    }
+
+    /** Formats message (Boost.Format syntax). Literal format is parsed only
+     *  once per call site.
+     */
+    template <std::size_t N, typename ...Args>
+    stream& operator()(const char (&format)[N], Args &&...args)
+    {
+        detail::parsed_format tmp;
+        const auto &parsed
+            (site_ ? detail::cachedFormat(site_->format, format, tmp)
+             : (tmp.parse(format), tmp));
+        detail::formatTo(*os_, parsed, format, std::forward<Args>(args)...);
+        return *this;
+    }
+
+    /** Mutable buffer: never cached.
+     */
+    template <std::size_t N, typename ...Args>
+    stream& operator()(char (&format)[N], Args &&...args)
+    {
+        detail::formatTo(*os_, format, std::forward<Args>(args)...);
+        return *this;
     }
 
     template <typename ...Args>
     stream& operator()(const std::string &format, Args &&...args)
     {
-        boost::format fmt(format);
-        fmt.exceptions(boost::io::no_error_bits);
-        detail::formatMessage(fmt, std::forward<Args>(args)...);
-        os_ << fmt;
+        detail::formatTo(*os_, format.c_str(), std::forward<Args>(args)...);
         return *this;
     }
 
@@ -88,15 +121,56 @@ public:
     {
         fmt.exceptions(boost::io::no_error_bits);
         detail::formatMessage(fmt, std::forward<Args>(args)...);
-        os_ << fmt;
+        *os_ << fmt;
         return *this;
     }
 
 private:
-    std::ostringstream os_;
+    /** Reusable per-thread buffer, no allocation once warm.
+     */
+    detail::scoped_line_stream os_;
+
+    /** Structured fields, borrowed on first kv().
+     */
+    detail::scoped_fields fields_;
+
     const location loc_;
     const level l_;
     SinkType &sink_;
+
+    /** Call site (nullptr if unknown), keeps parsed format.
+     */
+    const detail::callsite *site_;
+
+    /** Call site is forced on (see callsite_state::on).
+     */
+    const bool force_;
+
+    /** Statements suppressed by rate limiting since the last logged one.
+     */
+    const std::uint64_t suppressed_;
+};
+
+/** Binary log (LOGB) statement: message is formatted later, by the log
+ *  decoder, if binary log file is in use.
+ */
+template <typename SinkType>
+class binary_stream : public boost::noncopyable
+{
+public:
+    binary_stream(detail::binary_callsite &site, SinkType &sink)
+        : site_(site), sink_(sink)
+    {}
+
+    template <typename ...Args>
+    void operator()(const char *format, Args &&...args)
+    {
+        sink_.log_binary(site_, format, std::forward<Args>(args)...);
+    }
+
+private:
+    detail::binary_callsite &site_;
+    SinkType &sink_;
 };
 
 template <typename SinkType, typename ExcType>
@@ -153,13 +227,10 @@ private:
 #define DBGLOG_CONCATENATE2(arg1, arg2) arg1##arg2
 
 #define DBGLOG_EXPAND_1(LEVEL) \
-    if (!dbglog::detail::check_level(dbglog::LEVEL, dbglog::detail::deflog)); \
-    else dbglog::stream<dbglog::logger> \
-    (DBGLOG_PLACE, dbglog::LEVEL, dbglog::detail::deflog)
+    DBGLOG_RAW_EXPAND_1(dbglog::LEVEL)
 
 #define DBGLOG_EXPAND_2(LEVEL, SINK) \
-    if (!dbglog::detail::check_level(dbglog::LEVEL, SINK)); \
-    else dbglog::stream<decltype(SINK)>(DBGLOG_PLACE, dbglog::LEVEL, SINK)
+    DBGLOG_RAW_EXPAND_2(dbglog::LEVEL, SINK)
 
 #define DBGLOG_EXPAND_3(a, b, c) LOG_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_3
 #define DBGLOG_EXPAND_4(a, b, c, d) LOG_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_4
@@ -169,13 +240,15 @@ private:
 #define DBGLOG_EXPAND_8(a, b, c, d, e, f, g, h) LOG_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_8
 
 #define DBGLOG_RAW_EXPAND_1(LEVEL) \
-    if (!dbglog::detail::check_level(LEVEL, dbglog::detail::deflog)); \
-    else dbglog::stream<dbglog::logger> \
-    (DBGLOG_PLACE, LEVEL, dbglog::detail::deflog)
+    DBGLOG_RAW_EXPAND_2(LEVEL, dbglog::detail::deflog)
 
 #define DBGLOG_RAW_EXPAND_2(LEVEL, SINK) \
-    if (!dbglog::detail::check_level(LEVEL, SINK)); \
-    else dbglog::stream<decltype(SINK)>(DBGLOG_PLACE, LEVEL, SINK)
+    if (!DBGLOG_COMPILED_IN(LEVEL)); \
+    else if (const auto dbglog_callsite_check_ \
+             = dbglog::detail::check_callsite \
+             (DBGLOG_CALLSITE(LEVEL), LEVEL, SINK)); \
+    else dbglog::stream<decltype(SINK)> \
+             (dbglog_callsite_check_, LEVEL, SINK)
 
 #define DBGLOG_RAW_EXPAND_3(a, b, c) LOG_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_3
 #define DBGLOG_RAW_EXPAND_4(a, b, c, d) LOG_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_4
@@ -184,13 +257,83 @@ private:
 #define DBGLOG_RAW_EXPAND_7(a, b, c, d, e, f, g) LOG_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_7
 #define DBGLOG_RAW_EXPAND_8(a, b, c, d, e, f, g, h) LOG_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_8
 
+#define DBGLOG_LIMITED_EXPAND(LEVEL, SINK, LIMITER, ...) \
+    if (!DBGLOG_COMPILED_IN(LEVEL)); \
+    else if (const auto dbglog_callsite_check_ \
+             = dbglog::detail::check_callsite \
+             (DBGLOG_CALLSITE(LEVEL), LEVEL, SINK \
+              , DBGLOG_LIMITER(LIMITER), __VA_ARGS__)); \
+    else dbglog::stream<decltype(SINK)> \
+             (dbglog_callsite_check_, LEVEL, SINK)
+
+#define DBGLOG_EVERY_N_EXPAND_1(a) LOG_EVERY_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_1
+
+#define DBGLOG_EVERY_N_EXPAND_2(LEVEL, N) \
+    DBGLOG_LIMITED_EXPAND(dbglog::LEVEL, dbglog::detail::deflog \
+                          , every_n_limiter, N)
+
+#define DBGLOG_EVERY_N_EXPAND_3(LEVEL, N, SINK) \
+    DBGLOG_LIMITED_EXPAND(dbglog::LEVEL, SINK, every_n_limiter, N)
+
+#define DBGLOG_EVERY_N_EXPAND_4(a, b, c, d) LOG_EVERY_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_4
+#define DBGLOG_EVERY_N_EXPAND_5(a, b, c, d, e) LOG_EVERY_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_5
+#define DBGLOG_EVERY_N_EXPAND_6(a, b, c, d, e, f) LOG_EVERY_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_6
+#define DBGLOG_EVERY_N_EXPAND_7(a, b, c, d, e, f, g) LOG_EVERY_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_7
+#define DBGLOG_EVERY_N_EXPAND_8(a, b, c, d, e, f, g, h) LOG_EVERY_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_8
+
+#define DBGLOG_FIRST_N_EXPAND_1(a) LOG_FIRST_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_1
+
+#define DBGLOG_FIRST_N_EXPAND_2(LEVEL, N) \
+    DBGLOG_LIMITED_EXPAND(dbglog::LEVEL, dbglog::detail::deflog \
+                          , first_n_limiter, N)
+
+#define DBGLOG_FIRST_N_EXPAND_3(LEVEL, N, SINK) \
+    DBGLOG_LIMITED_EXPAND(dbglog::LEVEL, SINK, first_n_limiter, N)
+
+#define DBGLOG_FIRST_N_EXPAND_4(a, b, c, d) LOG_FIRST_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_4
+#define DBGLOG_FIRST_N_EXPAND_5(a, b, c, d, e) LOG_FIRST_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_5
+#define DBGLOG_FIRST_N_EXPAND_6(a, b, c, d, e, f) LOG_FIRST_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_6
+#define DBGLOG_FIRST_N_EXPAND_7(a, b, c, d, e, f, g) LOG_FIRST_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_7
+#define DBGLOG_FIRST_N_EXPAND_8(a, b, c, d, e, f, g, h) LOG_FIRST_N_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_8
+
+#define DBGLOG_EVERY_T_EXPAND_1(a) LOG_EVERY_T_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_1
+
+#define DBGLOG_EVERY_T_EXPAND_2(LEVEL, SECONDS) \
+    DBGLOG_LIMITED_EXPAND(dbglog::LEVEL, dbglog::detail::deflog \
+                          , every_t_limiter, SECONDS)
+
+#define DBGLOG_EVERY_T_EXPAND_3(LEVEL, SECONDS, SINK) \
+    DBGLOG_LIMITED_EXPAND(dbglog::LEVEL, SINK, every_t_limiter, SECONDS)
+
+#define DBGLOG_EVERY_T_EXPAND_4(a, b, c, d) LOG_EVERY_T_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_4
+#define DBGLOG_EVERY_T_EXPAND_5(a, b, c, d, e) LOG_EVERY_T_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_5
+#define DBGLOG_EVERY_T_EXPAND_6(a, b, c, d, e, f) LOG_EVERY_T_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_6
+#define DBGLOG_EVERY_T_EXPAND_7(a, b, c, d, e, f, g) LOG_EVERY_T_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_7
+#define DBGLOG_EVERY_T_EXPAND_8(a, b, c, d, e, f, g, h) LOG_EVERY_T_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_8
+
+#define DBGLOG_RATE_EXPAND_1(a) LOG_RATE_TAKES_EITHER_3_OR_4_ARGUMENTS_NOT_1
+#define DBGLOG_RATE_EXPAND_2(a, b) LOG_RATE_TAKES_EITHER_3_OR_4_ARGUMENTS_NOT_2
+
+#define DBGLOG_RATE_EXPAND_3(LEVEL, PER_SEC, BURST) \
+    DBGLOG_LIMITED_EXPAND(dbglog::LEVEL, dbglog::detail::deflog \
+                          , rate_limiter, PER_SEC, BURST)
+
+#define DBGLOG_RATE_EXPAND_4(LEVEL, PER_SEC, BURST, SINK) \
+    DBGLOG_LIMITED_EXPAND(dbglog::LEVEL, SINK, rate_limiter, PER_SEC, BURST)
+
+#define DBGLOG_RATE_EXPAND_5(a, b, c, d, e) LOG_RATE_TAKES_EITHER_3_OR_4_ARGUMENTS_NOT_5
+#define DBGLOG_RATE_EXPAND_6(a, b, c, d, e, f) LOG_RATE_TAKES_EITHER_3_OR_4_ARGUMENTS_NOT_6
+#define DBGLOG_RATE_EXPAND_7(a, b, c, d, e, f, g) LOG_RATE_TAKES_EITHER_3_OR_4_ARGUMENTS_NOT_7
+#define DBGLOG_RATE_EXPAND_8(a, b, c, d, e, f, g, h) LOG_RATE_TAKES_EITHER_3_OR_4_ARGUMENTS_NOT_8
+
 #define DBGLOG_ADD_LINE_NO(x) DBGLOG_ADD_LINE_NO1(x,__LINE__)
 #define DBGLOG_ADD_LINE_NO1(x, y) DBGLOG_ADD_LINE_NO2(x, y)
 #define DBGLOG_ADD_LINE_NO2(x, y) x##y
 
 #define DBGLOG_ONCE_EXPAND_1(LEVEL)                                     \
     static std::atomic<bool> DBGLOG_ADD_LINE_NO(dbglog_once_guard_)(false); \
-    if (!dbglog::detail::check_level                                    \
+    if (!DBGLOG_COMPILED_IN(dbglog::LEVEL)                              \
+        || !dbglog::detail::check_level                                 \
         (dbglog::LEVEL, dbglog::detail::deflog                          \
          , DBGLOG_ADD_LINE_NO(dbglog_once_guard_)));                    \
     else dbglog::stream<dbglog::logger>                                 \
@@ -198,7 +341,8 @@ private:
 
 #define DBGLOG_ONCE_EXPAND_2(LEVEL, SINK) \
     static std::atomic<bool> DBGLOG_ADD_LINE_NO(dbglog_once_guard_)(false); \
-    if (!dbglog::detail::check_level                                    \
+    if (!DBGLOG_COMPILED_IN(dbglog::LEVEL)                              \
+        || !dbglog::detail::check_level                                 \
         (dbglog::LEVEL, dbglog::detail::deflog                          \
          , DBGLOG_ADD_LINE_NO(dbglog_once_guard_)));                    \
     else dbglog::stream<decltype(SINK)>(DBGLOG_PLACE, dbglog::LEVEL, SINK)
@@ -210,6 +354,25 @@ private:
 #define DBGLOG_ONCE_EXPAND_7(a, b, c, d, e, f, g) LOGONCE_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_7
 #define DBGLOG_ONCE_EXPAND_8(a, b, c, d, e, f, g, h) LOGONCE_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_8
 
+#define DBGLOG_BINARY_EXPAND_1(LEVEL) \
+    if (!DBGLOG_COMPILED_IN(dbglog::LEVEL) \
+        || !dbglog::detail::check_level(dbglog::LEVEL, dbglog::detail::deflog)); \
+    else dbglog::binary_stream<dbglog::logger> \
+    (DBGLOG_BINARY_SITE(dbglog::LEVEL), dbglog::detail::deflog)
+
+#define DBGLOG_BINARY_EXPAND_2(LEVEL, SINK) \
+    if (!DBGLOG_COMPILED_IN(dbglog::LEVEL) \
+        || !dbglog::detail::check_level(dbglog::LEVEL, SINK)); \
+    else dbglog::binary_stream<decltype(SINK)> \
+    (DBGLOG_BINARY_SITE(dbglog::LEVEL), SINK)
+
+#define DBGLOG_BINARY_EXPAND_3(a, b, c) LOGB_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_3
+#define DBGLOG_BINARY_EXPAND_4(a, b, c, d) LOGB_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_4
+#define DBGLOG_BINARY_EXPAND_5(a, b, c, d, e) LOGB_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_5
+#define DBGLOG_BINARY_EXPAND_6(a, b, c, d, e, f) LOGB_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_6
+#define DBGLOG_BINARY_EXPAND_7(a, b, c, d, e, f, g) LOGB_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_7
+#define DBGLOG_BINARY_EXPAND_8(a, b, c, d, e, f, g, h) LOGB_TAKES_EITHER_1_OR_2_ARGUMENTS_NOT_8
+
 #define DBGLOG_THROW_EXPAND_1 THROW_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_1
 
 #define DBGLOG_THROW_EXPAND_2(LEVEL, EXCTYPE)                           \
@@ -242,8 +405,48 @@ private:
 #define DBGLOG_THROW_RAW_EXPAND_7(a, b, c, d, e, f, g) THROW_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_7
 #define DBGLOG_THROW_RAW_EXPAND_8(a, b, c, d, e, f, g, h) THROW_TAKES_EITHER_2_OR_3_ARGUMENTS_NOT_8
 
-#define DBGLOG_PLACE dbglog::location                       \
-    (__FILE__, (const char*)__FUNCTION__, __LINE__, true)
+/** Call site's location; formatted only once, on first use of the call site.
+ */
+#define DBGLOG_PLACE                                                    \
+    ([](const char *func) -> const dbglog::location& {                  \
+        static constexpr const char *file                               \
+            = dbglog::detail::basename(__FILE__);                       \
+        static const dbglog::location loc                               \
+            (dbglog::location::preformat(file, func, __LINE__));        \
+        return loc;                                                     \
+    }((const char*)__FUNCTION__))
+
+/** LOG/LOGR call site (see callsite.hpp), registered on first use.
+ */
+#define DBGLOG_CALLSITE(LEVEL)                                          \
+    ([](const char *func, dbglog::level l)                              \
+     -> const dbglog::detail::callsite& {                               \
+        static constexpr const char *file                               \
+            = dbglog::detail::basename(__FILE__);                       \
+        static const dbglog::detail::callsite site                      \
+            (dbglog::location::preformat(file, func, __LINE__), l);     \
+        return site;                                                    \
+    }((const char*)__FUNCTION__, LEVEL))
+
+/** Per-call-site rate limiter state (see detail/limit.hpp); constant
+ *  initialized, i.e. no initialization guard on the hot path.
+ */
+#define DBGLOG_LIMITER(TYPE)                                            \
+    ([]() -> dbglog::detail::TYPE& {                                    \
+        static dbglog::detail::TYPE limiter;                            \
+        return limiter;                                                 \
+    }())
+
+/** Binary log call site, registered on first use.
+ */
+#define DBGLOG_BINARY_SITE(LEVEL)                                       \
+    ([](const char *func) -> dbglog::detail::binary_callsite& {         \
+        static constexpr const char *file                               \
+            = dbglog::detail::basename(__FILE__);                       \
+        static dbglog::detail::binary_callsite site                     \
+            (dbglog::location::preformat(file, func, __LINE__), LEVEL); \
+        return site;                                                    \
+    }((const char*)__FUNCTION__))
 
 #endif // shared_dbglog_stream_hpp_included_
 
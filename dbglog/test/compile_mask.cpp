@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <boost/test/unit_test.hpp>
+
+// strip debug call sites from this file at compile time
+#define DBGLOG_COMPILE_MASK dbglog::noDebug
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+class CountingSink : public dbglog::Sink {
+public:
+    CountingSink() : dbglog::Sink(dbglog::mask("ALL"), "counter"), count(0) {}
+
+    virtual void write(const std::string&) { ++count; }
+
+    int count;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(dbglog_compiled_out)
+{
+    dbglog::logger sink(dbglog::all);
+    sink.log_console(false);
+    auto counter(dbglog::Sink::create<CountingSink>());
+    sink.addSink(counter);
+
+    int evaluated(0);
+    auto arg([&]() { return ++evaluated; });
+
+    LOG(debug, sink) << arg();
+    LOGR(dbglog::debug, sink) << arg();
+    LOGONCE(debug, sink) << arg();
+    BOOST_CHECK_EQUAL(evaluated, 0);
+    BOOST_CHECK_EQUAL(counter->count, 0);
+
+    LOG(info1, sink) << arg();
+    LOGR(dbglog::fatal, sink) << arg();
+    BOOST_CHECK_EQUAL(evaluated, 2);
+    BOOST_CHECK_EQUAL(counter->count, 2);
+    sink.clearSinks();
+}
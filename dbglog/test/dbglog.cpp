@@ -27,9 +27,53 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <new>
+#include <type_traits>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "dbglog/dbglog.hpp"
 #include "dbglog/mask.hpp"
+#include "dbglog/detail/blocks.hpp"
+
+namespace {
+
+/** Heap allocations made by current thread while counting is on.
+ */
+thread_local bool countAllocations(false);
+thread_local int allocations(0);
+
+} // namespace
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC cannot tell replaced operator new from the default one
+#  pragma GCC diagnostic ignored "-Wpragmas"
+#  pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+    if (countAllocations) { ++allocations; }
+    if (void *p = std::malloc(size ? size : 1)) { return p; }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
 
 void once() {
     LOGONCE(info4) << "once";
@@ -57,3 +101,1635 @@ BOOST_AUTO_TEST_CASE(dbglog_mask)
         std::cout << def <<  " -> error: " << e.what() << std::endl;
     }
 }
+
+namespace {
+
+class CountingSink : public dbglog::Sink {
+public:
+    CountingSink() : dbglog::Sink(dbglog::mask("ALL"), "counter"), count(0) {}
+
+    virtual void write(const std::string&) { ++count; }
+
+    std::atomic<int> count;
+};
+
+/** Collects logged messages (without time and location).
+ */
+class MessageSink : public dbglog::Sink {
+public:
+    MessageSink(const dbglog::mask &mask) : dbglog::Sink(mask, "message") {}
+
+    virtual void write(const std::string &line) {
+        const auto start(line.find("]: ") + 3);
+        messages.push_back(line.substr(start, line.rfind(" {") - start));
+        lines.push_back(line);
+    }
+
+    std::vector<std::string> messages;
+    std::vector<std::string> lines;
+};
+
+class RecordSink : public dbglog::Sink {
+public:
+    RecordSink(const dbglog::mask &mask) : dbglog::Sink(mask, "record") {}
+
+    virtual void write_record(const dbglog::record &r) {
+        levels.push_back(r.l);
+        modules.push_back(r.module);
+        messages.push_back(r.message);
+        lines.push_back(r.loc.line);
+        seconds.push_back(r.time.sec);
+        rendered.push_back(r.rendered());
+    }
+
+    virtual void write(const std::string&) {}
+
+    std::vector<dbglog::level> levels;
+    std::vector<std::string> modules;
+    std::vector<std::string> messages;
+    std::vector<int> lines;
+    std::vector<std::int64_t> seconds;
+    std::vector<bool> rendered;
+};
+
+/** Sink stuck in write until released.
+ */
+class StuckSink : public dbglog::Sink {
+public:
+    StuckSink()
+        : dbglog::Sink(dbglog::mask(dbglog::default_), "stuck")
+        , entered(false), released(false)
+    {}
+
+    virtual void write_record(const dbglog::record &r) {
+        entered = true;
+        while (!released) { ::usleep(1000); }
+        messages.push_back(r.message);
+        lines.push_back(r.line());
+    }
+
+    virtual void write(const std::string&) {}
+
+    std::atomic<bool> entered;
+    std::atomic<bool> released;
+    std::vector<std::string> messages;
+    std::vector<std::string> lines;
+};
+
+void callsiteNoisy(dbglog::logger &sink)
+{
+    LOG(info1, sink) << "noisy";
+    LOG(info4, sink) << "important";
+}
+
+void callsiteLater(dbglog::logger &sink)
+{
+    LOG(info1, sink) << "later";
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(dbglog_async)
+{
+    auto sink(dbglog::Sink::create<CountingSink>());
+    dbglog::add_sink(sink);
+    dbglog::log_async(true, 16);
+
+    std::vector<boost::thread> threads;
+    for (int t(0); t < 4; ++t) {
+        threads.emplace_back([]() {
+                for (int i(0); i < 100; ++i) { LOG(info1) << "async " << i; }
+            });
+    }
+    for (auto &thread : threads) { thread.join(); }
+
+    dbglog::flush();
+    BOOST_CHECK_EQUAL(sink->count, 400);
+
+    LOG(info1) << "last async line";
+    dbglog::shutdown();
+    BOOST_CHECK_EQUAL(sink->count, 401);
+
+    dbglog::remove_sink(sink);
+}
+
+namespace {
+
+/** Counts lines "<thread> <sequence>" logged out of per-thread order.
+ */
+class OrderSink : public dbglog::Sink {
+public:
+    OrderSink()
+        : dbglog::Sink(dbglog::mask("ALL"), "order"), count(0)
+        , misordered(0), next(4, 0)
+    {}
+
+    virtual void write(const std::string &line) {
+        int t(0), i(0);
+        const auto pos(line.find("]: "));
+        if (pos == std::string::npos) { return; }
+        std::istringstream(line.substr(pos + 3)) >> t >> i;
+
+        boost::mutex::scoped_lock guard(m);
+        ++count;
+        if (i != next[t]) { ++misordered; }
+        next[t] = i + 1;
+    }
+
+    boost::mutex m;
+    int count;
+    int misordered;
+    std::vector<int> next;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(dbglog_async_shutdown)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto order(dbglog::Sink::create<OrderSink>());
+    sink.addSink(order);
+    sink.log_async(true, 16);
+
+    // lines logged while the writer stops are written synchronously or
+    // drained, none is lost and each thread's lines keep their order;
+    // concurrent shutdowns are fine
+    std::vector<boost::thread> threads;
+    for (int t(0); t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+                for (int i(0); i < 1000; ++i) {
+                    LOG(info1, sink) << t << ' ' << i;
+                }
+            });
+    }
+    ::usleep(1000);
+    boost::thread other([&]() { sink.shutdown(); });
+    sink.shutdown();
+    other.join();
+    for (auto &thread : threads) { thread.join(); }
+
+    BOOST_CHECK_EQUAL(order->count, 4000);
+    BOOST_CHECK_EQUAL(order->misordered, 0);
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_async_restart)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto order(dbglog::Sink::create<OrderSink>());
+    sink.addSink(order);
+
+    // asynchronous mode is switched on and off while other threads log
+    std::atomic<int> running(4);
+    std::vector<boost::thread> threads;
+    for (int t(0); t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+                for (int i(0); i < 2000; ++i) {
+                    LOG(info1, sink) << t << ' ' << i;
+                }
+                --running;
+            });
+    }
+    for (int i(0); running; ++i) {
+        sink.log_async(!(i % 2), 1 + (i % 16));
+    }
+    for (auto &thread : threads) { thread.join(); }
+    sink.shutdown();
+
+    BOOST_CHECK_EQUAL(order->count, 8000);
+    BOOST_CHECK_EQUAL(order->misordered, 0);
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_async_lane_order)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto order(dbglog::Sink::create<OrderSink>());
+    sink.addSink(order);
+    sink.log_async(true, 8);
+
+    // every thread interleaves levels (i.e. lanes); writer merging lanes
+    // concurrently with producers must keep each thread's order
+    std::vector<boost::thread> threads;
+    for (int t(0); t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+                for (int i(0); i < 20000; ++i) {
+                    switch (i % 3) {
+                    case 0: LOG(info3, sink) << t << ' ' << i; break;
+                    case 1: LOG(warn2, sink) << t << ' ' << i; break;
+                    default: LOG(err2, sink) << t << ' ' << i; break;
+                    }
+                }
+            });
+    }
+    for (auto &thread : threads) { thread.join(); }
+    sink.log_async(false);
+
+    BOOST_CHECK_EQUAL(order->count, 80000);
+    BOOST_CHECK_EQUAL(order->misordered, 0);
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_sink_registry)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto permanent(dbglog::Sink::create<CountingSink>());
+    sink.addSink(permanent);
+
+    // sinks come and go while other threads log
+    std::atomic<int> running(4);
+    std::vector<boost::thread> threads;
+    for (int t(0); t < 4; ++t) {
+        threads.emplace_back([&]() {
+                for (int i(0); i < 5000; ++i) {
+                    LOG(info1, sink) << "line " << i;
+                }
+                --running;
+            });
+    }
+
+    int lateWrites(0);
+    while (running) {
+        auto temporary(dbglog::Sink::create<CountingSink>());
+        sink.addSink(temporary);
+        ::usleep(100);
+        sink.removeSink(temporary);
+
+        // nobody uses removed sink anymore
+        const int count(temporary->count);
+        ::usleep(100);
+        lateWrites += temporary->count - count;
+        BOOST_CHECK_EQUAL(temporary.use_count(), 1);
+    }
+    for (auto &thread : threads) { thread.join(); }
+
+    BOOST_CHECK_EQUAL(permanent->count, 20000);
+    BOOST_CHECK_EQUAL(lateWrites, 0);
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_any_mask)
+{
+    dbglog::logger sink(dbglog::default_);
+    BOOST_CHECK(!sink.check_level(dbglog::debug));
+    BOOST_CHECK(sink.check_level(dbglog::info3));
+    BOOST_CHECK(sink.check_level(dbglog::fatal));
+
+    // combined mask follows sink list and sink masks
+    auto counter(dbglog::Sink::create<CountingSink>());
+    sink.addSink(counter);
+    BOOST_CHECK(sink.check_level(dbglog::debug));
+
+    counter->set_mask(dbglog::noDebug);
+    BOOST_CHECK(!sink.check_level(dbglog::debug));
+    BOOST_CHECK(sink.check_level(dbglog::info1));
+
+    sink.set_mask(dbglog::none);
+    BOOST_CHECK(sink.check_level(dbglog::info1));
+
+    sink.removeSink(counter);
+    BOOST_CHECK(!sink.check_level(dbglog::info1));
+    BOOST_CHECK(sink.check_level(dbglog::fatal));
+
+    // detached sink does not affect logger anymore
+    counter->set_mask(dbglog::all);
+    BOOST_CHECK(!sink.check_level(dbglog::debug));
+
+    // shared mask follows logger
+    counter->shared_mask(true);
+    sink.addSink(counter);
+    BOOST_CHECK(!sink.check_level(dbglog::info1));
+    sink.set_mask(dbglog::all);
+    BOOST_CHECK(sink.check_level(dbglog::debug));
+    sink.clearSinks();
+    BOOST_CHECK(sink.check_level(dbglog::debug));
+}
+
+namespace {
+
+class PrefixSink : public dbglog::Sink {
+public:
+    PrefixSink()
+        : dbglog::Sink(dbglog::mask("ALL"), "prefix"), count(0), bad(0)
+    {}
+
+    virtual void write(const std::string &line) {
+        ++count;
+        if ((line.find(" <A>") == std::string::npos)
+            && (line.find(" <B>") == std::string::npos))
+        {
+            ++bad;
+        }
+    }
+
+    std::atomic<int> count;
+    std::atomic<int> bad;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(dbglog_reconfigure)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    sink.set_prefix(" <A>");
+    auto prefix(dbglog::Sink::create<PrefixSink>());
+    sink.addSink(prefix);
+
+    // configuration changes while other threads log
+    std::atomic<int> running(4);
+    std::vector<boost::thread> threads;
+    for (int t(0); t < 4; ++t) {
+        threads.emplace_back([&]() {
+                for (int i(0); i < 5000; ++i) {
+                    LOG(info3, sink) << "line " << i;
+                }
+                --running;
+            });
+    }
+    for (int i(0); running; ++i) {
+        sink.set_prefix((i % 2) ? " <A>" : " <B>");
+        sink.log_time_precision(i % 10);
+        sink.log_thread(i % 3);
+        sink.log_pid(i % 5);
+        sink.set_mask((i % 2) ? dbglog::all : dbglog::default_);
+    }
+    for (auto &thread : threads) { thread.join(); }
+
+    BOOST_CHECK_EQUAL(prefix->count, 20000);
+    BOOST_CHECK_EQUAL(prefix->bad, 0);
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_module_mask)
+{
+    const dbglog::mask m("I3W2E2,net=D,db/sql=I1");
+    BOOST_CHECK_EQUAL(m.get(), unsigned(dbglog::default_));
+    BOOST_CHECK_EQUAL(m.get("net"), unsigned(dbglog::debug));
+    BOOST_CHECK_EQUAL(m.get("net/http"), unsigned(dbglog::debug));
+    BOOST_CHECK_EQUAL(m.get("db"), unsigned(dbglog::default_));
+    BOOST_CHECK_EQUAL(m.get("db/sql/pool"), unsigned(dbglog::info1));
+    BOOST_CHECK_EQUAL(m.get("network"), unsigned(dbglog::default_));
+    BOOST_CHECK_EQUAL(m.as_string(), "I3W2E2,db/sql=I1,net=D");
+    BOOST_CHECK_EQUAL(dbglog::mask("net=ALL").get(), unsigned(dbglog::default_));
+    BOOST_CHECK_THROW(dbglog::mask("I3,D"), std::runtime_error);
+    BOOST_CHECK_THROW(dbglog::mask("I3,=D"), std::runtime_error);
+    BOOST_CHECK_THROW(dbglog::mask("I3,net=X"), std::runtime_error);
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    dbglog::module net("net", sink);
+    dbglog::module http("http", net);
+    dbglog::module db("db", sink);
+    BOOST_CHECK(!http.check_level(dbglog::debug));
+
+    // modules follow mask changes
+    sink.set_mask(m);
+    BOOST_CHECK_EQUAL(sink.get_mask_string(), m.as_string());
+    BOOST_CHECK(net.check_level(dbglog::debug));
+    BOOST_CHECK(http.check_level(dbglog::debug));
+    BOOST_CHECK(!http.check_level(dbglog::info1));
+    BOOST_CHECK(!db.check_level(dbglog::debug));
+    BOOST_CHECK(db.check_level(dbglog::info3));
+    BOOST_CHECK(!sink.check_level(dbglog::debug));
+
+    // copies are kept up to date as well
+    const dbglog::module copy(http);
+    sink.set_mask(dbglog::mask("ND,net/http=E1"));
+    BOOST_CHECK(!copy.check_level(dbglog::debug));
+    BOOST_CHECK(copy.check_level(dbglog::err1));
+    BOOST_CHECK(!copy.check_level(dbglog::info1));
+    BOOST_CHECK(net.check_level(dbglog::info1));
+
+    // module mask decides about log file output too, sinks have own masks
+    auto counter(dbglog::Sink::create<CountingSink>());
+    counter->set_mask(dbglog::mask("E1"));
+    sink.addSink(counter);
+    BOOST_CHECK(copy.check_level(dbglog::err1));
+    BOOST_CHECK(!copy.check_level(dbglog::warn1));
+
+    char path[] = "/tmp/dbglog-module-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+    BOOST_REQUIRE(sink.log_file(path));
+    sink.set_mask(dbglog::mask("E1,net=I4"));
+    LOG(info4, net) << "to file";
+    LOG(info3, net) << "nowhere";
+    LOG(err1, net) << "to sink";
+    LOG(info1, db) << "nowhere";
+    BOOST_CHECK_EQUAL(counter->count, 1);
+    BOOST_REQUIRE(sink.log_file(""));
+    std::ifstream f(path);
+    std::string line;
+    BOOST_REQUIRE(std::getline(f, line));
+    BOOST_CHECK(line.find("[net] to file") != std::string::npos);
+    BOOST_CHECK(!std::getline(f, line));
+    ::unlink(path);
+
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_module_before_logger)
+{
+    // like a namespace scope module initialized before its logger
+    typename std::aligned_storage<sizeof(dbglog::logger)
+                                  , alignof(dbglog::logger)>::type storage;
+    auto &sink(*reinterpret_cast<dbglog::logger*>(&storage));
+    {
+        dbglog::module early("early", sink);
+        new (&storage) dbglog::logger(dbglog::default_);
+        sink.log_console(false);
+        sink.set_mask(dbglog::mask("I3W2E2,early=E1"));
+
+        BOOST_CHECK(!early.check_level(dbglog::warn1));
+        BOOST_CHECK(early.check_level(dbglog::err1));
+        sink.set_mask(dbglog::mask("I3W2E2"));
+        BOOST_CHECK(early.check_level(dbglog::warn2));
+    }
+    sink.~logger();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_callsite)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    char path[] = "/tmp/dbglog-callsite-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+    BOOST_REQUIRE(sink.log_file(path));
+
+    auto lines([&]() -> std::vector<std::string> {
+            std::ifstream f(path);
+            std::vector<std::string> lines;
+            for (std::string line; std::getline(f, line); ) {
+                lines.push_back(line.substr(line.find("]: ") + 3));
+            }
+            return lines;
+        });
+
+    callsiteNoisy(sink);
+    std::size_t noisyLine(0);
+    for (const auto &site : dbglog::list_callsites()) {
+        if (site.func != "callsiteNoisy") { continue; }
+        BOOST_CHECK_EQUAL(site.file, "dbglog.cpp");
+        BOOST_CHECK(site.state == dbglog::callsite_state::mask);
+        if (site.l == dbglog::info1) { noisyLine = site.line; }
+    }
+    BOOST_REQUIRE(noisyLine);
+
+    // single statement on, mask still applies to others
+    BOOST_CHECK_EQUAL(dbglog::set_callsite_state
+                      (dbglog::callsite_state::on, "dbg*.cpp", "callsite*"
+                       , std::to_string(noisyLine)), 1u);
+    callsiteNoisy(sink);
+
+    // whole function off
+    BOOST_CHECK_EQUAL(dbglog::set_callsite_state
+                      (dbglog::callsite_state::off, "*", "callsiteNoisy")
+                      , 2u);
+    callsiteNoisy(sink);
+
+    // rules apply to call sites not executed yet
+    BOOST_CHECK_EQUAL(dbglog::set_callsite_state
+                      (dbglog::callsite_state::on, "*", "callsiteLater")
+                      , 0u);
+    callsiteLater(sink);
+
+    // back to defaults
+    dbglog::set_callsite_state(dbglog::callsite_state::mask, "*");
+    callsiteNoisy(sink);
+    callsiteLater(sink);
+
+    BOOST_REQUIRE(sink.log_file(""));
+    const std::vector<std::string> expected
+        { "important", "noisy {dbglog.cpp:callsiteNoisy():"
+          + std::to_string(noisyLine) + "}"
+          , "important", "later", "important" };
+    const auto got(lines());
+    BOOST_REQUIRE_EQUAL(got.size(), expected.size());
+    BOOST_CHECK(got[1] == expected[1]);
+    for (std::size_t i(0); i < got.size(); ++i) {
+        BOOST_CHECK_EQUAL(got[i].substr(0, got[i].find(' '))
+                          , expected[i].substr(0, expected[i].find(' ')));
+    }
+    ::unlink(path);
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_rate_limit)
+{
+    typedef std::vector<std::string> strings;
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto messages(dbglog::Sink::create<MessageSink>
+                  (dbglog::mask(dbglog::default_)));
+    auto &got(messages->messages);
+    sink.addSink(messages);
+
+    for (int i(0); i < 25; ++i) {
+        LOG_EVERY_N(info4, 10, sink) << "every " << i;
+    }
+    BOOST_CHECK(got == (strings{ "every 0"
+                    , "every 10 (suppressed 9 messages)"
+                    , "every 20 (suppressed 9 messages)" }));
+    got.clear();
+
+    // lines not allowed by mask are not counted
+    for (int i(0); i < 6; ++i) {
+        if (i == 3) { messages->set_mask(dbglog::mask(dbglog::all)); }
+        LOG_FIRST_N(info1, 2, sink) << "first " << i;
+    }
+    BOOST_CHECK(got == (strings{ "first 3", "first 4" }));
+    got.clear();
+
+    for (int i(0); i < 10; ++i) {
+        LOG_RATE(info4, 0.001, 3, sink) << "rate " << i;
+    }
+    BOOST_CHECK(got == (strings{ "rate 0", "rate 1", "rate 2" }));
+    got.clear();
+
+    for (int i(0); i < 5; ++i) {
+        if (i == 4) { ::usleep(300000); }
+        LOG_EVERY_T(info4, 0.2, sink) << "time " << i;
+    }
+    BOOST_CHECK(got == (strings{ "time 0"
+                    , "time 4 (suppressed 3 messages)" }));
+
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_collapse_repeated)
+{
+    typedef std::vector<std::string> strings;
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto messages(dbglog::Sink::create<MessageSink>
+                  (dbglog::mask(dbglog::default_)));
+    auto &got(messages->messages);
+    sink.addSink(messages);
+    sink.log_collapse_repeated();
+
+    for (int i(0); i < 5; ++i) { LOG(info4, sink) << "same"; }
+    LOG(info4, sink) << "other";
+    BOOST_CHECK(got == (strings{ "same", "last message repeated 4 times"
+                    , "other" }));
+    got.clear();
+
+    // same text from different call sites is not a repetition
+    for (int i(0); i < 2; ++i) {
+        LOG(info4, sink) << "text";
+        LOG(info4, sink) << "text";
+    }
+    BOOST_CHECK_EQUAL(got.size(), 4u);
+    got.clear();
+
+    // timeout expired: repetitions reported, line logged again
+    sink.log_collapse_repeated(100);
+    for (int i(0); i < 4; ++i) {
+        if (i == 3) { ::usleep(200000); }
+        LOG(info4, sink) << "timed";
+    }
+    BOOST_CHECK(got == (strings{ "timed", "last message repeated 2 times"
+                    , "timed" }));
+    got.clear();
+
+    // quiet thread: repetitions are reported after the timeout anyway
+    for (int i(0); i < 3; ++i) { LOG(info4, sink) << "quiet"; }
+    ::usleep(300000);
+    BOOST_CHECK(got == (strings{ "quiet", "last message repeated 2 times" }));
+    got.clear();
+
+    // exited thread: reported without waiting for the timeout
+    sink.log_collapse_repeated(60000);
+    boost::thread([&sink]() {
+            for (int i(0); i < 4; ++i) { LOG(info4, sink) << "gone"; }
+        }).join();
+    for (int i(0); (i < 300) && (got.size() < 2); ++i) { ::usleep(10000); }
+    BOOST_CHECK(got == (strings{ "gone", "last message repeated 3 times" }));
+    got.clear();
+
+    // heap built location is kept by value (large line numbers hash fine)
+    {
+        std::unique_ptr<std::string> file(new std::string("bind.py"));
+        for (int i(0); i < 2; ++i) {
+            sink.log(dbglog::info4, "bound"
+                     , dbglog::location(file->c_str(), "f", 100000));
+        }
+        std::fill(file->begin(), file->end(), 'x');
+    }
+    sink.log_collapse_repeated(0);
+    BOOST_REQUIRE_EQUAL(got.size(), 2u);
+    BOOST_CHECK_EQUAL(got[1], "last message repeated 1 times");
+    BOOST_CHECK(messages->lines.back().find("{bind.py:f():100000}")
+                != std::string::npos);
+    got.clear();
+
+    for (int i(0); i < 3; ++i) { LOG(info4, sink) << "same"; }
+    BOOST_CHECK_EQUAL(got.size(), 3u);
+
+    sink.clearSinks();
+}
+
+namespace {
+
+struct Point { int x, y; };
+
+std::ostream& operator<<(std::ostream &os, const Point &p)
+{
+    return os << p.x << "," << p.y;
+}
+
+template <typename ...Args>
+void checkFormat(const char *format, Args &&...args)
+{
+    std::ostringstream engine, boost;
+    dbglog::detail::formatTo(engine, format, args...);
+    dbglog::detail::boostFormatTo(boost, format, args...);
+    BOOST_CHECK_MESSAGE(engine.str() == boost.str()
+                        , "format <" << format << ">: <" << engine.str()
+                        << "> != <" << boost.str() << ">");
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(dbglog_format)
+{
+    // engine must match Boost.Format
+    checkFormat("plain text");
+    checkFormat("%d items, %s", 42, "done");
+    checkFormat("%5d|%-5d|%05d|%+d", 42, 42, -42, 42);
+    checkFormat("%x %X %#x %o", 255, 255, 255, 8);
+    checkFormat("%.2f %10.3f %e %E %g", 3.14159, 2.5, 12345.678, 0.5, 0.1);
+    checkFormat("%lu %lld %hd %zu", 1ul, 2ll, short(3), std::size_t(4));
+    checkFormat("100%% %s%%", "sure");
+    checkFormat("%2% %1% %2%", "a", "b");
+    checkFormat("%s %d", std::string("str"), true);
+    checkFormat("%-8s|%8s|", "left", std::string("right"));
+    checkFormat("%d %d %d", 1, 2);
+    checkFormat("%d", 1, 2, 3);
+    checkFormat("%s", Point{ 1, 2 });
+    checkFormat("%8s|", Point{ 1, 2 });
+    checkFormat("%c %.3s %|5|", 'x', "truncated", 7);
+    checkFormat("%1$d", 5);
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto messages(dbglog::Sink::create<MessageSink>
+                  (dbglog::mask(dbglog::default_)));
+    sink.addSink(messages);
+    for (int i(0); i < 2; ++i) {
+        LOG(info4, sink)("call %d of %s", i, "two");
+    }
+    char buffer[] = "mutable %d";
+    LOG(info4, sink)(buffer, 1);
+    buffer[9] = 's';
+    LOG(info4, sink)(buffer, "x");
+    BOOST_CHECK(messages->messages == (std::vector<std::string>{
+                "call 0 of two", "call 1 of two", "mutable 1"
+                    , "mutable x" }));
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_record)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto records(dbglog::Sink::create<RecordSink>
+                 (dbglog::mask(dbglog::default_)));
+    sink.addSink(records);
+    dbglog::module module("db", sink);
+
+    const auto now(std::time(nullptr));
+    const int line(__LINE__ + 1);
+    LOG(info3, sink) << "plain " << 1;
+    LOG(warn2, module) << "in module";
+
+    // nothing asked for text line: it has never been rendered
+    BOOST_CHECK(records->levels == (std::vector<dbglog::level>{
+                dbglog::info3, dbglog::warn2 }));
+    BOOST_CHECK(records->modules == (std::vector<std::string>{
+                "", "[db]" }));
+    BOOST_CHECK(records->messages == (std::vector<std::string>{
+                "plain 1", "in module" }));
+    BOOST_CHECK(records->lines == (std::vector<int>{ line, line + 1 }));
+    BOOST_CHECK(records->rendered == (std::vector<bool>{ false, false }));
+    for (auto sec : records->seconds) {
+        BOOST_CHECK(std::abs(sec - std::int64_t(now)) <= 1);
+    }
+
+    // text sinks still get the familiar line
+    auto messages(dbglog::Sink::create<MessageSink>
+                  (dbglog::mask(dbglog::default_)));
+    sink.addSink(messages);
+    LOG(info3, sink) << "both";
+    BOOST_CHECK(messages->messages == (std::vector<std::string>{ "both" }));
+    BOOST_CHECK_EQUAL(records->messages.back(), "both");
+
+    // the same goes through asynchronous writer
+    sink.log_async(true);
+    LOG(info4, sink) << "async";
+    sink.log_async(false);
+    BOOST_CHECK_EQUAL(records->messages.back(), "async");
+    BOOST_CHECK(messages->messages.back() == "async");
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_async_lanes)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto stuck(std::make_shared<StuckSink>());
+    sink.addSink(stuck);
+    sink.log_async(true, 2, dbglog::mask(dbglog::info1));
+
+    // first line occupies the writer
+    LOG(info4, sink) << "0";
+    while (!stuck->entered) { ::usleep(1000); }
+
+    // info lane (still holding "0") overflows and sheds, errors have their
+    // own lane and wait
+    for (int i(1); i <= 4; ++i) { LOG(info4, sink) << i; }
+    LOG(err2, sink) << "e1";
+    LOG(err2, sink) << "e2";
+    boost::thread release([&]() {
+            ::usleep(50000);
+            stuck->released = true;
+        });
+    LOG(err2, sink) << "e3";
+    release.join();
+    sink.flush();
+
+    BOOST_CHECK(stuck->messages == (std::vector<std::string>{
+                "0", "1", "e1", "e2", "e3" }));
+
+    const auto info(sink.async_stats(dbglog::async_lane::info));
+    BOOST_CHECK_EQUAL(info.enqueued, 2);
+    BOOST_CHECK_EQUAL(info.dropped, 3);
+    BOOST_CHECK_EQUAL(info.high_water, 2);
+    const auto err(sink.async_stats(dbglog::async_lane::err));
+    BOOST_CHECK_EQUAL(err.enqueued, 3);
+    BOOST_CHECK_EQUAL(err.dropped, 0);
+    BOOST_CHECK_EQUAL(sink.async_stats(dbglog::async_lane::warn).enqueued
+                      , 0);
+
+    // counters of finished thread's ring are kept once its ring is dropped
+    boost::thread([&]() { LOG(warn2, sink) << "w"; }).join();
+    sink.flush();
+    sink.flush();
+    BOOST_CHECK_EQUAL(sink.async_stats(dbglog::async_lane::warn).enqueued
+                      , 1);
+    BOOST_CHECK_EQUAL(sink.async_stats(dbglog::async_lane::info).enqueued
+                      , 2);
+
+    sink.log_async(false);
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_async_sink)
+{
+    typedef std::vector<std::string> strings;
+
+    auto run([](dbglog::overflow_policy policy
+                , const std::function<void(dbglog::logger&)> &log)
+             -> std::pair<strings, dbglog::async_sink_stats>
+    {
+        dbglog::logger sink(dbglog::default_);
+        sink.log_console(false);
+        auto stuck(std::make_shared<StuckSink>());
+        auto adapter(std::make_shared<dbglog::async_sink>(stuck, 2, policy));
+        sink.addSink(adapter);
+
+        // first record occupies the writer
+        LOG(info4, sink) << "0";
+        while (!stuck->entered) { ::usleep(1000); }
+        log(sink);
+
+        stuck->released = true;
+        adapter->flush();
+        sink.clearSinks();
+        return { stuck->messages, adapter->stats() };
+    });
+
+    auto four([](dbglog::logger &sink) {
+            for (int i(1); i <= 4; ++i) { LOG(info4, sink) << i; }
+        });
+
+    auto newest(run(dbglog::overflow_policy::drop_newest, four));
+    BOOST_CHECK(newest.first == (strings{ "0", "1", "2" }));
+    BOOST_CHECK_EQUAL(newest.second.enqueued, 3);
+    BOOST_CHECK_EQUAL(newest.second.dropped, 2);
+    BOOST_CHECK_EQUAL(newest.second.written, 3);
+    BOOST_CHECK_EQUAL(newest.second.high_water, 2);
+
+    auto oldest(run(dbglog::overflow_policy::drop_oldest, four));
+    BOOST_CHECK(oldest.first == (strings{ "0", "3", "4" }));
+    BOOST_CHECK_EQUAL(oldest.second.enqueued, 5);
+    BOOST_CHECK_EQUAL(oldest.second.dropped, 2);
+    BOOST_CHECK_EQUAL(oldest.second.written, 3);
+
+    // info is dropped, errors would wait
+    auto byLevel(run(dbglog::overflow_policy::drop_by_level
+                     , [](dbglog::logger &sink) {
+                         LOG(info4, sink) << "a";
+                         LOG(warn2, sink) << "b";
+                         LOG(info4, sink) << "c";
+                     }));
+    BOOST_CHECK(byLevel.first == (strings{ "0", "a", "b" }));
+    BOOST_CHECK_EQUAL(byLevel.second.dropped, 1);
+
+    // blocking policy loses nothing
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto messages(dbglog::Sink::create<MessageSink>
+                  (dbglog::mask(dbglog::default_)));
+    auto adapter(std::make_shared<dbglog::async_sink>(messages, 4));
+    sink.addSink(adapter);
+    for (int i(0); i < 100; ++i) { LOG(info4, sink) << i; }
+    adapter->flush();
+    BOOST_CHECK_EQUAL(messages->messages.size(), 100);
+    BOOST_CHECK_EQUAL(messages->messages.back(), "99");
+    BOOST_CHECK_EQUAL(adapter->stats().dropped, 0);
+    BOOST_CHECK_LE(adapter->stats().high_water, 4);
+
+    // adapter follows wrapped sink's mask
+    messages->set_mask(dbglog::mask(dbglog::err2));
+    BOOST_CHECK_EQUAL(adapter->get_mask(), messages->get_mask());
+    sink.clearSinks();
+
+    // queued record owns its location (e.g. built by a language binding)
+    auto stuck(std::make_shared<StuckSink>());
+    auto stuckAdapter(std::make_shared<dbglog::async_sink>(stuck, 4));
+    sink.addSink(stuckAdapter);
+    LOG(info4, sink) << "0";
+    while (!stuck->entered) { ::usleep(1000); }
+    {
+        std::unique_ptr<std::string> file(new std::string("bind.py"));
+        std::unique_ptr<std::string> func(new std::string("handler"));
+        sink.log(dbglog::info4, "heap"
+                 , dbglog::location(file->c_str(), func->c_str(), 42));
+        // stale pointers would read garbage
+        std::fill(file->begin(), file->end(), 'x');
+        std::fill(func->begin(), func->end(), 'x');
+    }
+    stuck->released = true;
+    stuckAdapter->flush();
+    sink.clearSinks();
+    BOOST_REQUIRE_EQUAL(stuck->lines.size(), 2);
+    BOOST_CHECK(stuck->lines[1].find("{bind.py:handler():42}")
+                != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_sanitize)
+{
+    namespace detail = dbglog::detail;
+    const auto text(detail::escape_mode::text);
+    const auto json(detail::escape_mode::json);
+
+    // SIMD scan agrees with scalar one for every length and position
+    const char specials[] = { '\n', '\x01', '\x1f', '\x7f', '\t', '"', '\\'
+                              , '\x80', '\xff', ' ' };
+    for (std::size_t size(0); size < 80; ++size) {
+        std::string buffer(size, 'a');
+        for (std::size_t pos(0); pos < size; ++pos) {
+            for (const char c : specials) {
+                buffer[pos] = c;
+                for (const auto mode : { text, json }) {
+                    BOOST_CHECK_EQUAL
+                        (detail::find_escape(buffer.data(), size, mode)
+                         , detail::find_escape_scalar(buffer.data(), size
+                                                      , mode));
+                }
+                buffer[pos] = 'a';
+            }
+        }
+        BOOST_CHECK_EQUAL(detail::find_escape(buffer.data(), size, text)
+                          , size);
+    }
+
+    auto escape([](const std::string &s, detail::escape_mode mode)
+                -> std::string
+    {
+        std::ostringstream os;
+        detail::write_escaped(os, s.data(), s.size(), mode);
+        return os.str();
+    });
+
+    BOOST_CHECK_EQUAL(escape("a\nb\x01\tc\x7f\"\\\xc3\xa9", text)
+                      , "a\\nb\\x01\tc\\x7f\"\\\xc3\xa9");
+    BOOST_CHECK_EQUAL(escape("a\"\\\t\x01\r\x7f", json)
+                      , "a\\\"\\\\\\t\\u0001\\r\x7f");
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto messages(dbglog::Sink::create<MessageSink>
+                  (dbglog::mask(dbglog::default_)));
+    sink.addSink(messages);
+
+    LOG(info3, sink) << "raw\nline";
+    sink.log_sanitize(true);
+    BOOST_CHECK(sink.get_log_sanitize());
+    LOG(info3, sink) << "forged\n2017-10-17 12:00:00 E1 [1]: boom";
+    LOG(info3, sink) << "clean";
+    BOOST_CHECK(messages->messages == (std::vector<std::string>{
+                "raw\nline", "forged\\n2017-10-17 12:00:00 E1 [1]: boom"
+                    , "clean" }));
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_no_allocation)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto counter(dbglog::Sink::create<CountingSink>());
+    sink.addSink(counter);
+    auto json(dbglog::Sink::create<dbglog::json_sink>());
+    BOOST_REQUIRE(json->open("/dev/null"));
+    sink.addSink(json);
+    dbglog::module module("module", sink);
+
+    auto log([&](int i) {
+            LOG(info3, sink) << "allocation free line " << i << ' ' << 0.5;
+            LOG(warn2, module) << "allocation free module line " << i;
+            LOG(info3, sink).kv("i", i).kv("name", "value")
+                << "allocation free fields";
+        });
+
+    // warm up thread's buffers
+    for (int i(0); i < 10; ++i) { log(i); }
+
+    countAllocations = true;
+    for (int i(0); i < 100; ++i) { log(i); }
+    countAllocations = false;
+
+    BOOST_CHECK_EQUAL(allocations, 0);
+    BOOST_CHECK_EQUAL(counter->count, 330);
+    sink.clearSinks();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_line_stream_trim)
+{
+    // huge line does not pin its memory once the stream is released
+    {
+        dbglog::detail::scoped_line_stream s;
+        *s << std::string(1 << 20, 'x');
+        BOOST_CHECK_EQUAL(s->str().size(), 1u << 20);
+    }
+    dbglog::detail::scoped_line_stream s;
+    BOOST_CHECK(s->str().empty());
+    BOOST_CHECK(s->str().capacity()
+                <= dbglog::detail::line_buffer::MaxKeep);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(dbglog_time)
+{
+    // "YYYY-MM-DD HH:MM:SS[.s...]", cached seconds prefix must not leak
+    // sub-second digits of longer precision into shorter one
+    for (unsigned short precision : { 9, 0, 3, 6, 1, 12 }) {
+        dbglog::detail::timebuffer b;
+        const std::string now(dbglog::detail::format_time(b, precision));
+        const auto digits((precision > 9) ? 9 : precision);
+        BOOST_CHECK_EQUAL(now.size(), 19 + (digits ? digits + 1 : 0));
+        BOOST_CHECK_EQUAL(now[10], ' ');
+        if (digits) { BOOST_CHECK_EQUAL(now[19], '.'); }
+    }
+}
+#endif
+
+namespace {
+
+/** Remembers last logged line.
+ */
+class LastLineSink : public dbglog::Sink {
+public:
+    LastLineSink() : dbglog::Sink(dbglog::mask("ALL"), "last") {}
+
+    virtual void write(const std::string &l) { line = l; }
+
+    std::string line;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(dbglog_location)
+{
+    static_assert(*dbglog::detail::basename("file.cpp") == 'f', "basename");
+#ifndef _WIN32
+    static_assert(*dbglog::detail::basename("/a/bb/file.cpp") == 'f'
+                  , "basename");
+    static_assert(*dbglog::detail::basename("a/") == '\0', "basename");
+#endif
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto last(dbglog::Sink::create<LastLineSink>());
+    sink.addSink(last);
+
+    // preformatted suffix is the same as formatted location
+    for (int i(0); i < 2; ++i) {
+        const dbglog::location loc(__FILE__, __FUNCTION__, __LINE__ + 1, true);
+        LOG(info3, sink) << "located";
+        std::ostringstream os;
+        os << "located " << loc << '\n';
+        const auto &line(last->line);
+        BOOST_REQUIRE_GE(line.size(), os.str().size());
+        BOOST_CHECK_EQUAL(line.substr(line.size() - os.str().size())
+                          , os.str());
+    }
+    sink.clearSinks();
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(dbglog_binary)
+{
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto last(dbglog::Sink::create<LastLineSink>());
+    sink.addSink(last);
+
+    auto log([&](int i) {
+            LOGB(info3, sink)("binary %d of %s (%.1f)", i, "three", 0.5);
+        });
+
+    // without binary file LOGB is LOG(...)(format, args...)
+    log(0);
+    BOOST_CHECK(last->line.find("binary 0 of three (0.5) {dbglog.cpp:")
+                != std::string::npos);
+
+    char path[] = "/tmp/dbglog-binary-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+
+    BOOST_REQUIRE(sink.log_binary_file(path));
+    for (int i(1); i <= 3; ++i) { log(i); }
+    // sinks still get text
+    BOOST_CHECK(last->line.find("binary 3 of three (0.5)")
+                != std::string::npos);
+    BOOST_REQUIRE(sink.log_binary_file(""));
+
+    std::ifstream f(path, std::ios_base::in | std::ios_base::binary);
+    const std::string content((std::istreambuf_iterator<char>(f))
+                              , std::istreambuf_iterator<char>());
+    ::unlink(path);
+
+    // header first, format stored once, arguments not rendered
+    BOOST_REQUIRE(!content.empty());
+    BOOST_CHECK_EQUAL(content[0], 'H');
+    const std::string format("binary %d of %s (%.1f)");
+    const auto pos(content.find(format));
+    BOOST_CHECK(pos != std::string::npos);
+    BOOST_CHECK(content.find(format, pos + 1) == std::string::npos);
+    BOOST_CHECK(content.find("(0.5)") == std::string::npos);
+
+    sink.clearSinks();
+}
+#endif
+
+#ifndef _WIN32
+namespace {
+
+std::size_t lineCount(const char *path)
+{
+    std::ifstream f(path);
+    std::size_t count(0);
+    for (std::string line; std::getline(f, line); ++count) {}
+    return count;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(dbglog_kv)
+{
+    typedef std::vector<std::string> strings;
+
+    /** Collects JSON encoded records.
+     */
+    class JsonSink : public dbglog::Sink {
+    public:
+        JsonSink() : dbglog::Sink(dbglog::mask(dbglog::default_), "json") {}
+
+        virtual void write_record(const dbglog::record &r) {
+            std::ostringstream os;
+            dbglog::json_sink::encode(os, r);
+            lines.push_back(os.str());
+        }
+
+        virtual void write(const std::string&) {}
+
+        strings lines;
+    };
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    auto json(std::make_shared<JsonSink>());
+    sink.addSink(json);
+    auto messages(dbglog::Sink::create<MessageSink>
+                  (dbglog::mask(dbglog::default_)));
+    sink.addSink(messages);
+    dbglog::module module("db", sink);
+
+    const std::uint64_t big(std::uint64_t(1) << 63);
+    LOG(info3, sink).kv("req", 17).kv("ms", 3.5).kv("ok", true)
+        .kv("big", big).kv("path", "/a\"b\n") << "done";
+    LOG(warn2, module).kv("c", 'x') << "in \"module\"";
+
+    // text line gets fields after message
+    BOOST_CHECK(messages->messages == (strings{
+                "done req=17 ms=3.5 ok=true big=9223372036854775808"
+                    " path=\"/a\\\"b\\n\""
+                    , "[db] in \"module\" c=\"x\"" }));
+
+    BOOST_REQUIRE_EQUAL(json->lines.size(), 2);
+    const auto &first(json->lines[0]);
+    BOOST_CHECK_EQUAL(first.find("{\"time\":"), 0);
+    BOOST_CHECK(first.find(",\"level\":\"I3\",\"pid\":")
+                != std::string::npos);
+    BOOST_CHECK(first.find(",\"message\":\"done\",\"file\":")
+                != std::string::npos);
+    BOOST_CHECK(first.find(",\"module\":") == std::string::npos);
+    BOOST_CHECK(first.find(",\"fields\":{\"req\":17,\"ms\":3.5"
+                           ",\"ok\":true,\"big\":9223372036854775808"
+                           ",\"path\":\"/a\\\"b\\n\"}}\n")
+                != std::string::npos);
+
+    const auto &second(json->lines[1]);
+    BOOST_CHECK(second.find(",\"level\":\"W2\",") != std::string::npos);
+    BOOST_CHECK(second.find(",\"module\":\"db\",\"message\":"
+                            "\"in \\\"module\\\"\",")
+                != std::string::npos);
+    BOOST_CHECK(second.find(",\"fields\":{\"c\":\"x\"}}\n")
+                != std::string::npos);
+    sink.clearSinks();
+
+    // JSON lines file
+    char path[] = "/tmp/dbglog-json-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+
+    auto file(dbglog::Sink::create<dbglog::json_sink>());
+    BOOST_REQUIRE(file->open(path));
+    sink.addSink(file);
+    for (int i(0); i < 3; ++i) { LOG(info3, sink).kv("i", i) << "line"; }
+    sink.clearSinks();
+    // plain line has no record
+    file->write(std::string("plain \"text\"\n"));
+    BOOST_REQUIRE(file->open(""));
+    BOOST_CHECK_EQUAL(lineCount(path), 4);
+    {
+        std::ifstream f(path);
+        std::string line, last;
+        while (std::getline(f, line)) { last = line; }
+        BOOST_CHECK_EQUAL(last, "{\"message\":\"plain \\\"text\\\"\"}");
+    }
+    ::unlink(path);
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_file_buffer)
+{
+    char path[] = "/tmp/dbglog-buffer-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    BOOST_REQUIRE(sink.log_file(path));
+    BOOST_REQUIRE(sink.log_file_buffer(1 << 16, 100000));
+
+    for (int i(0); i < 10; ++i) { LOG(info3, sink) << "buffered " << i; }
+    BOOST_CHECK_EQUAL(lineCount(path), 0);
+
+    // error lines go out immediately, after buffered ones
+    LOG(err2, sink) << "error";
+    BOOST_CHECK_EQUAL(lineCount(path), 11);
+
+    // buffer overflow
+    BOOST_REQUIRE(sink.log_file_buffer(256, 100000));
+    for (int i(0); i < 10; ++i) { LOG(info3, sink) << "buffered " << i; }
+    const auto count(lineCount(path));
+    BOOST_CHECK(count > 11);
+    BOOST_CHECK(count < 21);
+    sink.flush();
+    BOOST_CHECK_EQUAL(lineCount(path), 21);
+
+    // flush interval
+    BOOST_REQUIRE(sink.log_file_buffer(1 << 16, 10));
+    LOG(info3, sink) << "late";
+    ::usleep(200000);
+    BOOST_CHECK_EQUAL(lineCount(path), 22);
+
+    ::unlink(path);
+}
+#endif
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(dbglog_file_uring)
+{
+    char path[] = "/tmp/dbglog-uring-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    BOOST_REQUIRE(sink.log_file(path));
+    if (!sink.log_file_uring()) {
+        BOOST_TEST_MESSAGE("io_uring not available, skipping");
+        ::unlink(path);
+        return;
+    }
+
+    boost::thread_group threads;
+    for (int t(0); t < 4; ++t) {
+        threads.create_thread([&sink, t]() {
+            for (int i(0); i < 1000; ++i) {
+                LOG(info3, sink) << "uring " << t << " " << i;
+            }
+        });
+    }
+    threads.join_all();
+
+    // error line waits for everything queued before
+    LOG(err2, sink) << "error";
+    BOOST_CHECK_EQUAL(lineCount(path), 4001);
+
+    // uring on top of buffering
+    BOOST_REQUIRE(sink.log_file_buffer(1 << 16, 100000));
+    for (int i(0); i < 10; ++i) { LOG(info3, sink) << "buffered " << i; }
+    sink.flush();
+    BOOST_CHECK_EQUAL(lineCount(path), 4011);
+    BOOST_REQUIRE(sink.log_file_buffer(0));
+
+    // back to synchronous writes
+    BOOST_REQUIRE(sink.log_file_uring(false));
+    LOG(info3, sink) << "sync";
+    BOOST_CHECK_EQUAL(lineCount(path), 4012);
+
+    ::unlink(path);
+}
+#endif
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(dbglog_file_mmap)
+{
+    char path[] = "/tmp/dbglog-mmap-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    BOOST_REQUIRE(sink.log_file(path));
+    LOG(info3, sink) << "before mapping";
+    // small chunks: file grows many times
+    BOOST_REQUIRE(sink.log_file_mmap(4096));
+
+    boost::thread_group threads;
+    for (int t(0); t < 4; ++t) {
+        threads.create_thread([&sink, t]() {
+            for (int i(0); i < 1000; ++i) {
+                LOG(info3, sink) << "mmap " << t << " " << i;
+            }
+        });
+    }
+    threads.join_all();
+
+    // file is preallocated in whole chunks
+    struct ::stat st;
+    BOOST_REQUIRE(::stat(path, &st) == 0);
+    const auto mapped(st.st_size);
+    BOOST_CHECK_EQUAL(mapped % 4096, 0);
+
+    // switching off truncates file to used length
+    BOOST_REQUIRE(sink.log_file_mmap(0));
+    BOOST_REQUIRE(::stat(path, &st) == 0);
+    BOOST_CHECK(st.st_size <= mapped);
+    std::ifstream f(path);
+    const std::string content((std::istreambuf_iterator<char>(f))
+                              , std::istreambuf_iterator<char>());
+    BOOST_CHECK_EQUAL(content.size(), std::size_t(st.st_size));
+    BOOST_CHECK(content.find('\0') == std::string::npos);
+    BOOST_CHECK_EQUAL(content.back(), '\n');
+    BOOST_CHECK_EQUAL(lineCount(path), 4001);
+
+    // appends after regular write, reopen truncates as well
+    LOG(info3, sink) << "regular";
+    BOOST_REQUIRE(sink.log_file_mmap());
+    LOG(info3, sink) << "mapped again";
+    BOOST_REQUIRE(sink.log_file(""));
+    BOOST_CHECK_EQUAL(lineCount(path), 4003);
+    BOOST_REQUIRE(::stat(path, &st) == 0);
+    BOOST_CHECK(st.st_size < (1 << 20));
+
+    ::unlink(path);
+}
+#endif
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(dbglog_file_rotate)
+{
+    char path[] = "/tmp/dbglog-rotate-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+    const std::string base(path);
+    auto generation([&](int i) { return base + "." + std::to_string(i); });
+    auto count([&](int i) {
+            return lineCount(i ? generation(i).c_str() : path);
+        });
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    BOOST_REQUIRE(sink.log_file(path));
+
+    // tied descriptor follows the log file
+    const int tied(::open("/dev/null", O_WRONLY));
+    BOOST_REQUIRE(tied >= 0);
+    BOOST_REQUIRE(sink.tie(tied));
+
+    // manual rotation, two generations kept
+    BOOST_REQUIRE(sink.log_file_rotate(0, 0, 2));
+    for (int i(0); i < 3; ++i) { LOG(info3, sink) << "first " << i; }
+    BOOST_REQUIRE(sink.log_file_rotate_now());
+    BOOST_CHECK_EQUAL(count(0), 0);
+    BOOST_CHECK_EQUAL(count(1), 3);
+
+    BOOST_REQUIRE(::write(tied, "tied\n", 5) == 5);
+    LOG(info3, sink) << "second";
+    BOOST_REQUIRE(sink.log_file_rotate_now());
+    BOOST_CHECK_EQUAL(count(1), 2);
+    BOOST_CHECK_EQUAL(count(2), 3);
+
+    // the oldest generation is dropped
+    BOOST_REQUIRE(sink.log_file_rotate_now());
+    BOOST_CHECK_EQUAL(count(0), 0);
+    BOOST_CHECK_EQUAL(count(1), 0);
+    BOOST_CHECK_EQUAL(count(2), 2);
+    BOOST_CHECK(::access(generation(3).c_str(), F_OK) != 0);
+
+    // failed rotation keeps every generation and the live file in place
+    LOG(info3, sink) << "kept";
+    const auto blocker(generation(2) + ".drop");
+    BOOST_REQUIRE(::mkdir(blocker.c_str(), 0700) == 0);
+    BOOST_REQUIRE(::mkdir((blocker + "/x").c_str(), 0700) == 0);
+    BOOST_CHECK(!sink.log_file_rotate_now());
+    ::rmdir((blocker + "/x").c_str());
+    ::rmdir(blocker.c_str());
+    BOOST_CHECK_EQUAL(count(0), 1);
+    BOOST_CHECK_EQUAL(count(1), 0);
+    BOOST_CHECK_EQUAL(count(2), 2);
+    BOOST_CHECK(::access((base + ".rotating").c_str(), F_OK) != 0);
+    LOG(info3, sink) << "still here";
+    BOOST_CHECK_EQUAL(count(0), 2);
+
+    // size limit: background rotation while threads log, nothing is lost
+    BOOST_REQUIRE(sink.log_file_rotate(4096, 0, 100));
+    boost::thread_group threads;
+    for (int t(0); t < 4; ++t) {
+        threads.create_thread([&sink, t]() {
+            for (int i(0); i < 500; ++i) {
+                LOG(info3, sink) << "rotate " << t << " " << i;
+            }
+        });
+    }
+    threads.join_all();
+    BOOST_REQUIRE(sink.log_file_rotate(0));
+
+    std::size_t total(count(0));
+    int generations(0);
+    for (int i(1); i <= 100; ++i) {
+        if (::access(generation(i).c_str(), F_OK)) { break; }
+        total += count(i);
+        generations = i;
+    }
+    // two lines left from manual rotation at the end, two from failed one
+    BOOST_CHECK_EQUAL(total, 2004);
+    BOOST_CHECK(generations > 2);
+
+    BOOST_REQUIRE(sink.log_file(""));
+    ::close(tied);
+    ::unlink(path);
+    for (int i(1); i <= 100; ++i) { ::unlink(generation(i).c_str()); }
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_file_compress)
+{
+    char path[] = "/tmp/dbglog-compress-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+    const std::string base(path);
+    auto generation([&](int i) { return base + "." + std::to_string(i); });
+    auto exists([](const std::string &p) {
+            return ::access(p.c_str(), F_OK) == 0;
+        });
+    auto waitFor([](const std::function<bool()> &done) {
+            for (int i(0); (i < 1000) && !done(); ++i) { ::usleep(10000); }
+            return done();
+        });
+    auto cleanup([&]() {
+            ::unlink(path);
+            ::unlink((base + ".gz.tmp").c_str());
+            for (int i(1); i <= 3; ++i) {
+                ::unlink(generation(i).c_str());
+                ::unlink((generation(i) + ".gz").c_str());
+            }
+        });
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    BOOST_REQUIRE(sink.log_file(path));
+    BOOST_REQUIRE(sink.log_file_rotate(0, 0, 3));
+    if (!sink.log_file_compress(true, 0, 0)) {
+        BOOST_TEST_MESSAGE("compression not available");
+        BOOST_REQUIRE(sink.log_file(""));
+        cleanup();
+        return;
+    }
+
+    for (int g(0); g < 2; ++g) {
+        for (int i(0); i < 200; ++i) {
+            LOG(info3, sink) << "compressed line " << g << " " << i;
+        }
+        BOOST_REQUIRE(sink.log_file_rotate_now());
+    }
+
+    // both generations end up gzipped, plain ones removed
+    BOOST_CHECK(waitFor([&]() {
+                return exists(generation(1) + ".gz")
+                    && exists(generation(2) + ".gz")
+                    && !exists(generation(1)) && !exists(generation(2));
+            }));
+
+    std::ifstream gz(generation(1) + ".gz", std::ios::binary);
+    unsigned char magic[2] = { 0, 0 };
+    gz.read(reinterpret_cast<char*>(magic), 2);
+    BOOST_CHECK_EQUAL(int(magic[0]), 0x1f);
+    BOOST_CHECK_EQUAL(int(magic[1]), 0x8b);
+
+    struct ::stat st;
+    BOOST_REQUIRE(::stat((generation(1) + ".gz").c_str(), &st) == 0);
+    BOOST_CHECK(st.st_size > 0);
+    BOOST_CHECK(st.st_size < 200 * 20);
+
+    // budget fits only the newest generation: older one is pruned
+    BOOST_REQUIRE(sink.log_file_compress(true, 0, st.st_size));
+    BOOST_CHECK(waitFor([&]() { return !exists(generation(2) + ".gz"); }));
+    BOOST_CHECK(exists(generation(1) + ".gz"));
+
+    // throttled compressor never holds up rotation nor switching off
+    BOOST_REQUIRE(sink.log_file_compress(true, 1, 0));
+    for (int i(0); i < 200; ++i) { LOG(info3, sink) << "slow " << i; }
+    BOOST_REQUIRE(sink.log_file_rotate_now());
+    BOOST_CHECK(waitFor([&]() { return exists(base + ".gz.tmp"); }));
+    BOOST_REQUIRE(sink.log_file_rotate_now());
+    BOOST_REQUIRE(sink.log_file_compress(false));
+    BOOST_CHECK(exists(generation(2)));
+    BOOST_CHECK(exists(generation(3) + ".gz"));
+    BOOST_CHECK(!exists(base + ".gz.tmp"));
+
+    BOOST_REQUIRE(sink.log_file(""));
+    cleanup();
+}
+
+BOOST_AUTO_TEST_CASE(dbglog_file_blocks)
+{
+    namespace blocks = dbglog::detail::blocks;
+
+    char path[] = "/tmp/dbglog-blocks-XXXXXX";
+    const int fd(::mkstemp(path));
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+    const std::string base(path);
+    const std::string index(base + blocks::indexSuffix);
+    auto slurp([](const std::string &p) {
+            std::ifstream f(p, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(f)
+                               , std::istreambuf_iterator<char>());
+        });
+    auto entries([&](const std::string &p) {
+            const auto raw(slurp(p));
+            std::vector<blocks::entry> out;
+            if ((raw.size() < blocks::headerSize)
+                || raw.compare(0, sizeof(blocks::magic), blocks::magic
+                               , sizeof(blocks::magic)))
+            {
+                return out;
+            }
+            for (auto i(blocks::headerSize);
+                 i + blocks::entry::encodedSize <= raw.size();
+                 i += blocks::entry::encodedSize)
+            {
+                out.emplace_back();
+                out.back().decode(raw.data() + i);
+            }
+            return out;
+        });
+    auto cleanup([&]() {
+            ::unlink(path);
+            ::unlink(index.c_str());
+            ::unlink((base + ".1").c_str());
+            ::unlink((base + ".1" + blocks::indexSuffix).c_str());
+        });
+
+    dbglog::logger sink(dbglog::default_);
+    sink.log_console(false);
+    BOOST_REQUIRE(sink.log_file(path));
+    // blocks are written only when full or before an error
+    if (!sink.log_file_blocks(4096, 100000)) {
+        BOOST_TEST_MESSAGE("block output not available");
+        BOOST_REQUIRE(sink.log_file(""));
+        cleanup();
+        return;
+    }
+
+    std::size_t raw(0);
+    for (int i(0); i < 300; ++i) {
+        if (i == 150) {
+            LOG(err2, sink) << "block error";
+        }
+        LOG(info3, sink) << "block line " << i;
+    }
+    sink.flush_file();
+
+    const auto log(slurp(base));
+    const auto e(entries(index));
+    BOOST_REQUIRE(e.size() > 2);
+
+    // blocks are contiguous and independent
+    std::string lines, text;
+    int errors(0);
+    for (std::size_t i(0); i < e.size(); ++i) {
+        BOOST_CHECK_EQUAL(e[i].offset
+                          , i ? e[i - 1].offset + e[i - 1].size : 0);
+        if (i) {
+            BOOST_CHECK((e[i].time.sec > e[i - 1].time.sec)
+                        || ((e[i].time.sec == e[i - 1].time.sec)
+                            && (e[i].time.nsec >= e[i - 1].time.nsec)));
+        }
+        BOOST_REQUIRE(e[i].offset + e[i].size <= log.size());
+        BOOST_REQUIRE(dbglog::detail::block_compressor::decompress
+                      (log.data() + e[i].offset, e[i].size, lines));
+        BOOST_CHECK_EQUAL(lines.size(), e[i].rawSize);
+        BOOST_CHECK(e[i].levels & dbglog::info3);
+        if (e[i].levels & dbglog::err2) {
+            ++errors;
+            // error line closes its block
+            BOOST_CHECK(lines.find("block error") != std::string::npos);
+        }
+        raw += lines.size();
+        text += lines;
+    }
+    BOOST_CHECK_EQUAL(errors, 1);
+    BOOST_CHECK_EQUAL(e.back().offset + e.back().size, log.size());
+    BOOST_CHECK_EQUAL(std::count(text.begin(), text.end(), '\n'), 301);
+    BOOST_CHECK(text.find("block line 299") != std::string::npos);
+    BOOST_CHECK(log.size() * 3 < raw);
+
+    // rotated file keeps its index, new one starts from scratch
+    BOOST_REQUIRE(sink.log_file_rotate(0, 0, 1));
+    BOOST_REQUIRE(sink.log_file_rotate_now());
+    BOOST_CHECK_EQUAL(entries(base + ".1" + blocks::indexSuffix).size()
+                      , e.size());
+    LOG(info3, sink) << "after rotation";
+    sink.flush_file();
+    const auto rotated(entries(index));
+    BOOST_REQUIRE_EQUAL(rotated.size(), 1u);
+    BOOST_CHECK_EQUAL(rotated[0].offset, 0u);
+    BOOST_CHECK_EQUAL(rotated[0].size, slurp(base).size());
+
+    // blocks still in flight in io_uring count when index is reopened
+    if (sink.log_file_uring()) {
+        for (int i(0); i < 300; ++i) {
+            LOG(info3, sink) << "uring line " << i;
+        }
+        BOOST_REQUIRE(sink.log_file(path));
+        LOG(info3, sink) << "reopened";
+        sink.flush_file();
+
+        const auto reopened(entries(index));
+        BOOST_REQUIRE(reopened.size() > 2);
+        for (std::size_t i(1); i < reopened.size(); ++i) {
+            BOOST_CHECK_EQUAL(reopened[i].offset
+                              , reopened[i - 1].offset
+                              + reopened[i - 1].size);
+        }
+        BOOST_CHECK_EQUAL(reopened.back().offset + reopened.back().size
+                          , slurp(base).size());
+        BOOST_REQUIRE(sink.log_file_uring(false));
+    }
+
+    BOOST_REQUIRE(sink.log_file_blocks(0));
+    BOOST_REQUIRE(sink.log_file(""));
+    cleanup();
+}
+#endif
@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Logging latency benchmark: measures how long LOG statements block the
+ *  calling threads with synchronous, io_uring and memory mapped log file
+ *  writes.
+ *
+ *  Usage: dbglog-bench [--threads N] [--lines N] [--size N] [--file PATH]
+ *                      [--mode sync|uring|mmap|all]
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+
+#include "dbglog/dbglog.hpp"
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+struct Config {
+    unsigned int threads = 4;
+    unsigned int lines = 100000;
+    std::size_t size = 100;
+    std::string file = "dbglog-bench.log";
+};
+
+/** Runs one benchmark and returns per-call latencies (ns) of all threads.
+ */
+std::vector<std::uint64_t> run(const Config &config)
+{
+    const std::string payload(config.size, 'x');
+    std::vector<std::vector<std::uint64_t>> latencies(config.threads);
+
+    std::vector<boost::thread> workers;
+    for (unsigned int t(0); t < config.threads; ++t) {
+        workers.emplace_back([&, t]()
+        {
+            auto &lat(latencies[t]);
+            lat.reserve(config.lines);
+            for (unsigned int i(0); i < config.lines; ++i) {
+                const auto start(clock_type::now());
+                LOG(info3) << "line " << i << ": " << payload;
+                lat.push_back(std::chrono::duration_cast
+                              <std::chrono::nanoseconds>
+                              (clock_type::now() - start).count());
+            }
+        });
+    }
+    for (auto &w : workers) { w.join(); }
+    dbglog::flush();
+
+    std::vector<std::uint64_t> all;
+    for (const auto &lat : latencies) {
+        all.insert(all.end(), lat.begin(), lat.end());
+    }
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+void report(const std::string &mode, const std::vector<std::uint64_t> &lat)
+{
+    const auto pct([&](double p) -> double {
+        if (lat.empty()) { return 0.0; }
+        return lat[std::min(lat.size() - 1, std::size_t(p * lat.size()))]
+            / 1000.0;
+    });
+
+    std::cout << boost::format("%-6s %10d calls  p50 %8.2f us  p99 %8.2f us"
+                               "  p99.9 %8.2f us  max %10.2f us\n")
+        % mode % lat.size() % pct(0.5) % pct(0.99) % pct(0.999)
+        % (lat.empty() ? 0.0 : lat.back() / 1000.0);
+}
+
+bool bench(const Config &config, const std::string &mode)
+{
+    if (!dbglog::log_file(config.file) || !dbglog::log_file_truncate()) {
+        return false;
+    }
+
+    if (!dbglog::log_file_uring(mode == "uring")
+        || !dbglog::log_file_mmap((mode == "mmap") ? (64 << 20) : 0))
+    {
+        std::cout << mode << ": not available\n";
+        return true;
+    }
+
+    report(mode, run(config));
+    return true;
+}
+
+int usage(const char *prog)
+{
+    std::cerr << "usage: " << prog
+              << " [--threads N] [--lines N] [--size N] [--file PATH]"
+                 " [--mode sync|uring|mmap|all]\n";
+    return EXIT_FAILURE;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Config config;
+    std::string mode("all");
+
+    for (int i(1); i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (i + 1 >= argc) { return usage(argv[0]); }
+        if (arg == "--threads") {
+            config.threads = std::atoi(argv[++i]);
+        } else if (arg == "--lines") {
+            config.lines = std::atoi(argv[++i]);
+        } else if (arg == "--size") {
+            config.size = std::atoi(argv[++i]);
+        } else if (arg == "--file") {
+            config.file = argv[++i];
+        } else if (arg == "--mode") {
+            mode = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    dbglog::log_console(false);
+    dbglog::set_mask(dbglog::all);
+
+    for (const char *m : { "sync", "uring", "mmap" }) {
+        if (((mode == m) || (mode == "all")) && !bench(config, m)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    dbglog::log_file("");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Block compressed log reader (see logger_file::log_file_blocks): prints
+ *  blocks overlapping given time range and containing lines of given
+ *  levels. Only selected blocks are read and decompressed, located via the
+ *  block index (FILE.idx).
+ *
+ *  Usage: dbglog-blocks [--list] [--from SEC] [--to SEC] [--levels MASK]
+ *                       FILE
+ *
+ *  SEC: Unix time (seconds), MASK: log mask (e.g. E2 for errors)
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <limits>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+
+#include "dbglog/mask.hpp"
+#include "dbglog/detail/blocks.hpp"
+
+namespace blocks = dbglog::detail::blocks;
+
+namespace {
+
+std::vector<blocks::entry> loadIndex(const std::string &path)
+{
+    std::ifstream f(path, std::ios_base::in | std::ios_base::binary);
+    if (!f) { throw std::runtime_error("Cannot open <" + path + ">."); }
+
+    char header[blocks::headerSize];
+    std::uint32_t version;
+    if (!f.read(header, sizeof(header))
+        || std::memcmp(header, blocks::magic, sizeof(blocks::magic)))
+    {
+        throw std::runtime_error("Not a dbglog block index.");
+    }
+    std::memcpy(&version, header + sizeof(blocks::magic), sizeof(version));
+    if (version != blocks::version) {
+        throw std::runtime_error("Unsupported block index version.");
+    }
+
+    std::vector<blocks::entry> index;
+    char raw[blocks::entry::encodedSize];
+    // incomplete trailing entry is being written right now
+    while (f.read(raw, sizeof(raw))) {
+        index.emplace_back();
+        index.back().decode(raw);
+    }
+    return index;
+}
+
+int usage(const char *self)
+{
+    std::cerr << "usage: " << self << " [--list] [--from SEC] [--to SEC]"
+              " [--levels MASK] FILE\n"
+              << "    SEC: Unix time (seconds), MASK: log mask (e.g. E2)\n";
+    return EXIT_FAILURE;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool list(false);
+    std::int64_t from(std::numeric_limits<std::int64_t>::min());
+    std::int64_t to(std::numeric_limits<std::int64_t>::max());
+    unsigned int levels(dbglog::all);
+    std::string file;
+
+    for (int i(1); i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (arg == "--list") {
+            list = true;
+        } else if ((arg == "--from") && (i + 1 < argc)) {
+            from = std::atoll(argv[++i]);
+        } else if ((arg == "--to") && (i + 1 < argc)) {
+            to = std::atoll(argv[++i]);
+        } else if ((arg == "--levels") && (i + 1 < argc)) {
+            levels = dbglog::mask(std::string(argv[++i])).get();
+        } else if ((arg == "-h") || (arg == "--help") || !file.empty()) {
+            return usage(argv[0]);
+        } else {
+            file = arg;
+        }
+    }
+    if (file.empty()) { return usage(argv[0]); }
+
+    try {
+        const auto index(loadIndex(file + blocks::indexSuffix));
+        std::ifstream f(file, std::ios_base::in | std::ios_base::binary);
+        if (!f) { throw std::runtime_error("Cannot open <" + file + ">."); }
+
+        std::string compressed, lines;
+        for (std::size_t i(0); i < index.size(); ++i) {
+            const auto &e(index[i]);
+            // block lasts until the next one starts
+            const auto end((i + 1 < index.size())
+                           ? index[i + 1].time.sec
+                           : std::numeric_limits<std::int64_t>::max());
+            if ((e.time.sec > to) || (end < from)) { continue; }
+            if (e.levels && !(e.levels & levels)) { continue; }
+
+            if (list) {
+                std::printf("%llu %u %u %lld.%09u 0x%05x\n"
+                            , static_cast<unsigned long long>(e.offset)
+                            , unsigned(e.size), unsigned(e.rawSize)
+                            , static_cast<long long>(e.time.sec)
+                            , unsigned(e.time.nsec), unsigned(e.levels));
+                continue;
+            }
+
+            compressed.resize(e.size);
+            if (!f.seekg(e.offset) || !f.read(&compressed[0], e.size)
+                || !dbglog::detail::block_compressor::decompress
+                (compressed.data(), compressed.size(), lines))
+            {
+                throw std::runtime_error("Corrupted block at offset "
+                                         + std::to_string(e.offset) + ".");
+            }
+            std::cout.write(lines.data(), lines.size());
+        }
+    } catch (const std::exception &e) {
+        std::cout.flush();
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Binary log decoder: turns binary log (see LOGB) into text log lines.
+ *
+ *  Usage: dbglog-decode [--precision N] [FILE...]
+ *
+ *  Reads standard input if no file is given.
+ */
+
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include "dbglog/detail/binary.hpp"
+#include "dbglog/detail/log_helpers.hpp"
+
+namespace binary = dbglog::detail::binary;
+
+namespace {
+
+struct Callsite {
+    dbglog::level l;
+    std::string file;
+    std::string func;
+    std::uint32_t line;
+    std::string format;
+};
+
+class Decoder {
+public:
+    Decoder(std::istream &is, std::ostream &os, unsigned short precision)
+        : is_(is), os_(os), precision_(precision), pid_(0)
+    {}
+
+    void run() {
+        char type;
+        bool first(true);
+        while (is_.get(type)) {
+            if (first && (type != binary::header)) {
+                throw std::runtime_error("Not a binary dbglog file.");
+            }
+            first = false;
+
+            switch (type) {
+            case binary::header: header(); break;
+            case binary::callsite: callsite(); break;
+            case binary::entry: entry(false); break;
+            case binary::formatEntry: entry(true); break;
+            default:
+                throw std::runtime_error("Unknown record type.");
+            }
+        }
+    }
+
+private:
+    template <typename T> T get() {
+        T value;
+        if (!is_.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+            throw std::runtime_error("Truncated record.");
+        }
+        return value;
+    }
+
+    template <typename Size> std::string getString() {
+        std::string value(get<Size>(), '\0');
+        if (!value.empty() && !is_.read(&value[0], value.size())) {
+            throw std::runtime_error("Truncated record.");
+        }
+        return value;
+    }
+
+    void header() {
+        char magic[sizeof(binary::magic)];
+        if (!is_.read(magic, sizeof(magic))
+            || std::memcmp(magic, binary::magic, sizeof(magic)))
+        {
+            throw std::runtime_error("Bad binary dbglog header.");
+        }
+        if (get<std::uint32_t>() != binary::version) {
+            throw std::runtime_error("Unsupported binary dbglog version.");
+        }
+        pid_ = get<std::uint32_t>();
+        // new session, call site ids start over
+        callsites_.clear();
+    }
+
+    void callsite() {
+        const auto id(get<std::uint32_t>());
+        auto &cs(callsites_[id]);
+        cs.l = static_cast<dbglog::level>(get<std::uint32_t>());
+        cs.file = getString<std::uint16_t>();
+        cs.func = getString<std::uint16_t>();
+        cs.line = get<std::uint32_t>();
+        cs.format = getString<std::uint16_t>();
+    }
+
+    void entry(bool ownFormat) {
+        const auto id(get<std::uint32_t>());
+        const auto sec(get<std::int64_t>());
+        const auto nsec(get<std::uint32_t>());
+        const auto thread(getString<std::uint16_t>());
+        const auto prefix(getString<std::uint16_t>());
+        std::string format;
+        if (ownFormat) { format = getString<std::uint16_t>(); }
+
+        auto fcallsites(callsites_.find(id));
+        if (fcallsites == callsites_.end()) {
+            throw std::runtime_error("Entry of unknown call site.");
+        }
+        const auto &cs(fcallsites->second);
+
+        boost::format fmt(ownFormat ? format : cs.format);
+        fmt.exceptions(boost::io::no_error_bits);
+        for (auto argc(get<std::uint8_t>()); argc; --argc) { arg(fmt); }
+
+        time(sec, nsec);
+        os_ << ' ' << dbglog::detail::level2string(cs.l)
+            << " [" << pid_ << '(' << thread << ")]: ";
+        if (!prefix.empty()) { os_ << prefix << ' '; }
+        os_ << fmt << " {" << cs.file << ':' << cs.func << "():"
+            << cs.line << "}\n";
+    }
+
+    void arg(boost::format &fmt) {
+        switch (get<char>()) {
+        case binary::signedInt: fmt % get<std::int64_t>(); break;
+        case binary::unsignedInt: fmt % get<std::uint64_t>(); break;
+        case binary::floating: fmt % get<double>(); break;
+        case binary::character: fmt % get<char>(); break;
+        case binary::boolean: fmt % bool(get<std::uint8_t>()); break;
+        case binary::string: fmt % getString<std::uint32_t>(); break;
+        default:
+            throw std::runtime_error("Unknown argument type.");
+        }
+    }
+
+    /** Same layout as dbglog::detail::format_time.
+     */
+    void time(std::int64_t sec, std::uint32_t nsec) {
+        const std::time_t t(sec);
+        std::tm bd;
+#ifdef _WIN32
+        ::localtime_s(&bd, &t);
+#else
+        ::localtime_r(&t, &bd);
+#endif
+        char b[64];
+        os_.write(b, std::strftime(b, sizeof(b), "%Y-%m-%d %H:%M:%S", &bd));
+        if (!precision_) { return; }
+
+        std::snprintf(b, sizeof(b), ".%09u", unsigned(nsec));
+        os_.write(b, 1 + precision_);
+    }
+
+    std::istream &is_;
+    std::ostream &os_;
+    unsigned short precision_;
+    std::uint32_t pid_;
+    std::map<std::uint32_t, Callsite> callsites_;
+};
+
+int usage(const char *self)
+{
+    std::cerr << "usage: " << self << " [--precision N] [FILE...]\n"
+              << "    N: sub-second digits, 0-9\n";
+    return EXIT_FAILURE;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned short precision(0);
+    std::vector<std::string> files;
+
+    for (int i(1); i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if ((arg == "--precision") && (i + 1 < argc)) {
+            precision = std::atoi(argv[++i]);
+            if (precision > 9) { return usage(argv[0]); }
+        } else if ((arg == "-h") || (arg == "--help")) {
+            return usage(argv[0]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    try {
+        if (files.empty()) {
+            Decoder(std::cin, std::cout, precision).run();
+        }
+
+        for (const auto &file : files) {
+            std::ifstream f(file, std::ios_base::in | std::ios_base::binary);
+            if (!f) {
+                std::cerr << argv[0] << ": cannot open <" << file << ">.\n";
+                return EXIT_FAILURE;
+            }
+            Decoder(f, std::cout, precision).run();
+        }
+    } catch (const std::exception &e) {
+        std::cout.flush();
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
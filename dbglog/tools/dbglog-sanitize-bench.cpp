@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Message sanitizing microbenchmark: throughput of control character
+ *  scanning (SIMD vs scalar, memcpy for reference) and of escaping.
+ *
+ *  Usage: dbglog-sanitize-bench [--size N] [--bytes N]
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <functional>
+
+#include <boost/format.hpp>
+
+#include "dbglog/detail/sanitize.hpp"
+#include "dbglog/detail/line_buffer.hpp"
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+namespace detail = dbglog::detail;
+
+struct Config {
+    std::size_t size = 256;
+    std::size_t bytes = std::size_t(1) << 30;
+};
+
+/** Keeps results alive.
+ */
+volatile std::size_t sink;
+
+/** Runs fn over buffer until config.bytes are processed, returns GB/s.
+ */
+double measure(const Config &config, const std::string &buffer
+               , const std::function<std::size_t(const std::string&)> &fn)
+{
+    const auto rounds(std::max(config.bytes / buffer.size()
+                               , std::size_t(1)));
+    std::size_t acc(0);
+    const auto start(clock_type::now());
+    for (std::size_t i(0); i < rounds; ++i) { acc += fn(buffer); }
+    const double ns(std::chrono::duration_cast<std::chrono::nanoseconds>
+                    (clock_type::now() - start).count());
+    sink = acc;
+    return (rounds * buffer.size()) / ns;
+}
+
+void bench(const Config &config, const char *name, const std::string &buffer)
+{
+    std::vector<char> copy(buffer.size());
+    const auto text(detail::escape_mode::text);
+
+    const auto memcpyRate(measure(config, buffer, [&](const std::string &b)
+    {
+        std::memcpy(copy.data(), b.data(), b.size());
+        return std::size_t(copy[b.size() / 2]);
+    }));
+
+    const auto simd(measure(config, buffer, [&](const std::string &b)
+    {
+        return detail::find_escape(b.data(), b.size(), text);
+    }));
+
+    const auto scalar(measure(config, buffer, [&](const std::string &b)
+    {
+        return detail::find_escape_scalar(b.data(), b.size(), text);
+    }));
+
+    detail::scoped_line_stream os;
+    const auto escape(measure(config, buffer, [&](const std::string &b)
+    {
+        os->reset();
+        detail::write_escaped(*os, b.data(), b.size(), text);
+        return os->str().size();
+    }));
+
+    std::cout << boost::format("%-6s %6d B  memcpy %6.2f GB/s  %s %6.2f GB/s"
+                               "  scalar %6.2f GB/s  escape %6.2f GB/s\n")
+        % name % buffer.size() % memcpyRate % detail::find_escape_isa()
+        % simd % scalar % escape;
+}
+
+int usage(const char *prog)
+{
+    std::cerr << "usage: " << prog << " [--size N] [--bytes N]\n";
+    return EXIT_FAILURE;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Config config;
+
+    for (int i(1); i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (i + 1 >= argc) { return usage(argv[0]); }
+        if (arg == "--size") {
+            config.size = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--bytes") {
+            config.bytes = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (!config.size) { return usage(argv[0]); }
+
+    std::string clean(config.size, 'x');
+    for (std::size_t i(0); i < clean.size(); ++i) {
+        clean[i] = char(' ' + (i % 95));
+    }
+
+    // trailing newline: whole buffer is scanned, tail escaped
+    std::string dirty(clean);
+    dirty.back() = '\n';
+
+    bench(config, "clean", clean);
+    bench(config, "dirty", dirty);
+    return EXIT_SUCCESS;
+}